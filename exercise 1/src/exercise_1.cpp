@@ -6,16 +6,58 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/shader_m.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/render_state.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/normal_matrix.h>
+#include <learnopengl/transform_batch.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/philox.h>
+#include <learnopengl/particle_store.h>
+#include <learnopengl/particle_renderer.h>
+#include <learnopengl/particle_compute.h>
+#include <learnopengl/particle_collisions.h>
+#include <learnopengl/barnes_hut.h>
+#include <learnopengl/sph_fluid.h>
+#include <learnopengl/sphere_lod.h>
+#include <learnopengl/scene_node.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/fixed_timestep.h>
+#include <learnopengl/simulation_thread.h>
+#include <learnopengl/streaming_buffer.h>
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
-void renderSphere(unsigned int X_SEGMENTS, unsigned int Y_SEGMENTS);
-void init_particles_position();
-glm::vec3 move_particle(int particle_number, float unit);
+void init_particles_position(ParticleStore& store);
+void update_particles(ParticleStore& store);
+void step_particles(ParticleStore& store, ThreadPool& pool);
+void update_light_block();
+void set_view_uniforms(Shader& shader, const glm::mat4& projection, const glm::mat4& view);
+void queue_particles_per_object(RenderQueue& queue, Shader& shader, const ParticleStore& store, const glm::mat4& projection, const glm::mat4& view);
+unsigned int select_particle_lod(const glm::mat4& projection, const glm::mat4& view);
+void queue_particles_instanced(RenderQueue& queue, Shader& shader, const ParticleRenderer& renderer, const glm::mat4& view, float interpolation, bool impostors);
+void run_particle_benchmark(GLFWwindow* window, Shader& ourShader, Shader& particleShader, Shader& impostorShader, ParticleRenderer& renderer);
+void run_thread_benchmark(unsigned int max_threads);
+void run_collision_benchmark(unsigned int max_threads);
+void run_nbody_benchmark(unsigned int threads);
+void run_sph_benchmark(unsigned int max_threads);
+void update_particle_system_node();
+void update_scene_matrices();
+void run_normal_matrix_benchmark(GLFWwindow* window, Shader& particleShader, ParticleRenderer& renderer);
+void run_transform_benchmark();
+void run_streaming_benchmark(GLFWwindow* window, Shader& impostorShader);
+bool run_gpu_simulation_check(ParticleRenderer& renderer);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -23,13 +65,77 @@ const unsigned int SCR_HEIGHT = 600;
 
 // particles - settings
 const unsigned int PARTICLES_NUMBER = 2000;
-std::vector<glm::vec3> particles_position(PARTICLES_NUMBER);
-bool init_position = false;
+const float PARTICLE_SCALE = 0.005f;
+const float PARTICLE_STEP = 0.01f;
+const float PARTICLE_BOX = 0.4f;
+const float PARTICLE_INIT_BOX = 0.19f;
+const unsigned long long PARTICLE_SEED = 2020;
+// particles stepped by one thread in a chunk of the parallel update
+const unsigned int PARTICLES_PER_CHUNK = 4096;
+// most threads --threads accepts: every one of them gets its own queue and std::thread
+const unsigned int MAX_THREADS = 1024;
+// random walk steps per second when the simulation runs on its own thread
+const double SIMULATION_RATE = 60.0;
+// N-body mode: G times the total mass of the particles, softening length, default opening angle, and the
+// simulated time of a step (the particles start at rest, a cold collapse takes a few hundred steps)
+const float NBODY_COUPLING = 1.0f;
+const float NBODY_SOFTENING = 2.0f * PARTICLE_SCALE;
+const float NBODY_THETA = 0.5f;
+const float NBODY_TIME_STEP = 0.001f;
+ParticleStore particles(PARTICLES_NUMBER);
+CounterRng particle_rng(PARTICLE_SEED);
+ThreadPool* particle_pool = NULL;
+// the random walk runs in a compute shader on the instance buffer instead of on the CPU (--gpu-sim, GL 4.3)
+bool gpu_simulation = false;
+// the particles are hard spheres of radius PARTICLE_SCALE that do not pass through each other (--collisions)
+bool particle_collisions = false;
+ParticleCollisions particle_collider;
+// the particles attract (or repel) each other instead of walking at random, with Barnes-Hut forces (--nbody)
+bool particle_nbody = false;
+NBodySystem particle_nbody_system(NBODY_COUPLING, NBODY_SOFTENING, NBODY_THETA, NBODY_TIME_STEP);
+// the particles are a fluid filling the cube, released from a block at one side (--sph)
+bool particle_fluid = false;
+SphFluid particle_fluid_system;
+// shared between the render thread (input) and the simulation thread
+std::atomic<bool> init_position(false);
+std::atomic<bool> initialized(false);
 bool init_position_press = false;
-bool initialized = false;
+// how the particles are drawn: a mesh and a draw call per particle, one instanced draw of the sphere mesh,
+// or one instanced draw of ray-cast quads (the cheapest in vertices, for millions of particles)
+enum ParticleDrawMode { PARTICLES_PER_OBJECT, PARTICLES_INSTANCED, PARTICLES_IMPOSTOR, PARTICLE_DRAW_MODES };
+ParticleDrawMode particle_draw_mode = PARTICLES_INSTANCED;
+bool particle_draw_mode_press = false;
 float rotation_angle_particle_system_y = 0.0f;
 float rotation_angle_particle_system_x = 0.0f;
 float rotation_angle_particle_system_z = 0.0f;
+// the particle system rotation is computed once per frame in this node, the particles and the two cubes
+// enclosing them only add their own offset and scale
+SceneNode particle_system_node;
+SceneNode wire_cube_node(&particle_system_node);
+SceneNode glass_cube_node(&particle_system_node);
+
+// sphere meshes shared by the particles, one per level of detail
+SphereLod sphere_lod;
+
+// light and material uniform blocks of the light_casters programs: the light is rewritten once per frame,
+// the materials never change and are selected by binding one of them
+UniformBuffer<LightBlock> light_buffer;
+UniformBuffer<MaterialBlock> material_buffer;
+enum MaterialIndex { PARTICLE_MATERIAL, CUBE_MATERIAL };
+
+// model matrices of the objects drawn with the light_casters programs and their normal matrices, computed in one
+// batch per frame so that the vertex shaders only multiply by them; the particles share the particle system ones
+enum SceneObject { PARTICLE_SYSTEM_OBJECT, WIRE_CUBE_OBJECT, GLASS_CUBE_OBJECT, SCENE_OBJECTS };
+glm::mat4 scene_models[SCENE_OBJECTS];
+glm::mat3 scene_normals[SCENE_OBJECTS];
+// fixed-function state of every draw: everything is opaque but the glass cube, which blends over what is behind it
+const RenderState OPAQUE_STATE;
+const RenderState TRANSPARENT_STATE = RenderState().WithBlend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// draws of the frame, recorded in any order and issued sorted by program, material and vertex array
+RenderQueue render_queue;
+// transforms of the particles drawn one by one, turned into model matrices in one batch per frame
+TransformBatch particle_transforms;
+std::vector<glm::mat4> particle_models;
 
 // camera
 glm::vec3 camera_position(0.0f, 0.0f, 4.0f);
@@ -37,6 +143,7 @@ glm::vec3 camera_position(0.0f, 0.0f, 4.0f);
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+float lastTitleUpdate = 0.0f;
 
 // lighting
 glm::vec3 lightPos(0.0f, 0.0f, 2.0f);
@@ -44,8 +151,188 @@ float rotation_angle_lamp_y = 0.0f;
 float rotation_angle_lamp_x = 0.0f;
 float rotation_angle_lamp_z = 0.0f;
 
-int main()
+int main(int argc, char** argv)
 {
+    // command line: --particles N sets the particle count, --seed N the random walk seed,
+    // --threads N the threads stepping the particles (0 = one per core),
+    // --sim-rate HZ the simulation tick rate, --no-sim-thread steps the particles once per frame on the render thread,
+    // --impostors starts with the ray-cast impostor particles, --gpu-sim steps the particles in a compute shader,
+    // --collisions keeps the particles from passing through each other (CPU only),
+    // --nbody gravity|charges moves the particles under their mutual attraction or repulsion (CPU only),
+    // --theta X sets the Barnes-Hut opening angle of the N-body forces (0 < X < 2 / sqrt(3)),
+    // --sph makes the particles a fluid (CPU only),
+    // --bench-particles runs the particle rendering benchmark, --bench-threads the update scaling benchmark,
+    // --bench-collisions the collision grid benchmark, --bench-nbody the Barnes-Hut force and energy benchmark,
+    // --bench-sph the fluid step scaling benchmark,
+    // --bench-normals the normal matrix benchmark, --bench-transforms the batched transform benchmark,
+    // --bench-streaming the dynamic buffer upload benchmark, --check-gpu-sim compares the compute shader random walk
+    // with the CPU one and exits with 1 if they disagree (runs on Mesa's llvmpipe with LIBGL_ALWAYS_SOFTWARE=1)
+    bool benchmark = false;
+    bool normal_benchmark = false;
+    bool transform_benchmark = false;
+    bool thread_benchmark = false;
+    bool collision_benchmark = false;
+    bool nbody_benchmark = false;
+    bool sph_benchmark = false;
+    bool streaming_benchmark = false;
+    bool gpu_simulation_check = false;
+    bool simulation_thread = true;
+    double simulation_rate = SIMULATION_RATE;
+    unsigned int threads = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+        {
+            // particles are numbered with 32-bit counters (CounterRng, ParticleGrid), and all of them have to fit in
+            // the instance buffer
+            std::size_t most = ParticleRenderer::MaxInstances();
+            if (most > 0xffffffffu)
+                most = 0xffffffffu;
+            char* end = NULL;
+            long long count = std::strtoll(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || count <= 0 || (unsigned long long)count > most)
+            {
+                std::cout << "--particles takes a count from 1 to " << most << ", not " << argv[i] << std::endl;
+                return -1;
+            }
+            particles.Resize((std::size_t)count);
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            // strtoull would take a minus sign and wrap the value around
+            char* end = NULL;
+            errno = 0;
+            unsigned long long seed = std::strtoull(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || errno == ERANGE || std::strchr(argv[i], '-') != NULL)
+            {
+                std::cout << "--seed takes an unsigned 64-bit number, not " << argv[i] << std::endl;
+                return -1;
+            }
+            particle_rng = CounterRng(seed);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            char* end = NULL;
+            long count = std::strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || count < 0 || count > (long)MAX_THREADS)
+            {
+                std::cout << "--threads takes a count from 0 (one per core) to " << MAX_THREADS << ", not " << argv[i] << std::endl;
+                return -1;
+            }
+            threads = (unsigned int)count;
+        }
+        else if (std::strcmp(argv[i], "--sim-rate") == 0 && i + 1 < argc)
+        {
+            // a tick rate of 0 never steps, and a negative, NaN or infinite one breaks the FixedTimestep accumulator
+            char* end = NULL;
+            simulation_rate = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(simulation_rate > 0.0 && simulation_rate <= 1e6))
+            {
+                std::cout << "--sim-rate takes a tick rate above 0 and up to 1e6 Hz, not " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--no-sim-thread") == 0)
+            simulation_thread = false;
+        else if (std::strcmp(argv[i], "--impostors") == 0)
+            particle_draw_mode = PARTICLES_IMPOSTOR;
+        else if (std::strcmp(argv[i], "--gpu-sim") == 0)
+            gpu_simulation = true;
+        else if (std::strcmp(argv[i], "--collisions") == 0)
+            particle_collisions = true;
+        else if (std::strcmp(argv[i], "--nbody") == 0 && i + 1 < argc)
+        {
+            const char* force = argv[++i];
+            if (std::strcmp(force, "gravity") != 0 && std::strcmp(force, "charges") != 0)
+            {
+                std::cout << "--nbody takes gravity or charges, not " << force << std::endl;
+                return -1;
+            }
+            particle_nbody = true;
+            particle_nbody_system.coupling = std::strcmp(force, "charges") == 0 ? -NBODY_COUPLING : NBODY_COUPLING;
+        }
+        else if (std::strcmp(argv[i], "--theta") == 0 && i + 1 < argc)
+        {
+            // from 2 / sqrt(3) on, a particle can take the node holding it as a single mass
+            char* end = NULL;
+            double theta = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(theta > 0.0 && theta < 2.0 / std::sqrt(3.0)))
+            {
+                std::cout << "--theta takes an opening angle above 0 and below 2 / sqrt(3) = 1.1547, not " << argv[i] << std::endl;
+                return -1;
+            }
+            particle_nbody_system.theta = (float)theta;
+        }
+        else if (std::strcmp(argv[i], "--sph") == 0)
+            particle_fluid = true;
+        else if (std::strcmp(argv[i], "--bench-particles") == 0)
+            benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-threads") == 0)
+            thread_benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-collisions") == 0)
+            collision_benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-nbody") == 0)
+            nbody_benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-sph") == 0)
+            sph_benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-normals") == 0)
+            normal_benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-transforms") == 0)
+            transform_benchmark = true;
+        else if (std::strcmp(argv[i], "--bench-streaming") == 0)
+            streaming_benchmark = true;
+        else if (std::strcmp(argv[i], "--check-gpu-sim") == 0)
+            gpu_simulation_check = true;
+    }
+
+    // the CPU modes replace each other, the first of fluid, N-body and collisions wins
+    if (particle_fluid && (particle_nbody || particle_collisions))
+    {
+        std::cout << "--sph, --nbody and --collisions are exclusive, the particles are a fluid" << std::endl;
+        particle_nbody = particle_collisions = false;
+    }
+    if (particle_nbody && particle_collisions)
+    {
+        std::cout << "--nbody and --collisions are exclusive, the particles move under N-body forces" << std::endl;
+        particle_collisions = false;
+    }
+
+    // every simulation mode, and every comparison between them, relies on the generator
+    if (!PhiloxSelfCheck())
+    {
+        std::cout << "Philox self-check failed: the random numbers do not match the Random123 known answers" << std::endl;
+        return -1;
+    }
+
+    if (thread_benchmark)
+    {
+        run_thread_benchmark(threads);
+        return 0;
+    }
+    if (collision_benchmark)
+    {
+        run_collision_benchmark(threads);
+        return 0;
+    }
+    if (nbody_benchmark)
+    {
+        run_nbody_benchmark(threads);
+        return 0;
+    }
+    if (sph_benchmark)
+    {
+        run_sph_benchmark(threads);
+        return 0;
+    }
+    if (transform_benchmark)
+    {
+        run_transform_benchmark();
+        return 0;
+    }
+
+    ThreadPool pool(threads);
+    particle_pool = &pool;
+
     glfwInit();
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -55,6 +342,9 @@ int main()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    // the check draws nothing
+    if (gpu_simulation_check)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
@@ -76,13 +366,24 @@ int main()
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST);
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
     Shader ourShader("light_casters.vs", "light_casters.fs");
     Shader lamp_shader("vertex_shader_lamp.vs", "fragment_shader_lamp.fs");
+    Shader particleShader("particle_instanced.vs", "light_casters.fs");
+    Shader impostorShader("particle_impostor.vs", "particle_impostor.fs");
+
+    Shader* block_shaders[] = { &ourShader, &particleShader, &impostorShader };
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        BindUniformBlock(block_shaders[i]->ID, "LightBlock", LIGHT_BLOCK_BINDING);
+        BindUniformBlock(block_shaders[i]->ID, "MaterialBlock", MATERIAL_BLOCK_BINDING);
+    }
+    light_buffer.Create(LIGHT_BLOCK_BINDING, 1, GL_DYNAMIC_DRAW);
+    light_buffer.Bind(0);
+
+    std::vector<MaterialBlock> materials(2);
+    materials[PARTICLE_MATERIAL] = MaterialBlock(glm::vec3(0.5f), glm::vec3(0.5f), glm::vec3(0.5f), 84.0f);
+    materials[CUBE_MATERIAL] = MaterialBlock(glm::vec3(0.02f, 0.2f, 0.02f), glm::vec3(1.0f, 0.6f, 0.07f), glm::vec3(0.6f, 0.7f, 0.6f), 84.0f);
+    material_buffer.Create(MATERIAL_BLOCK_BINDING, materials);
 
     float cube_vertices[] = {
         // positions            //normals
@@ -170,12 +471,12 @@ int main()
 
     glGenVertexArrays(1, &cubeVAO);
 
-    glBindVertexArray(cubeVAO);
+    GlobalGLState().BindVertexArray(cubeVAO);
 
     glGenBuffers(1, &cubeVBO);
     glGenBuffers(1, &cubeEBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
 
@@ -185,16 +486,85 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+    GlobalGLState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(wired_cube_indices), wired_cube_indices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
 
-    init_particles_position();
+    // the particles share the sphere meshes, the instance buffer carries their positions
+    sphere_lod.Build();
+    ParticleRenderer particle_renderer;
+    for (unsigned int i = 0; i < SphereLod::LEVELS; i++)
+        particle_renderer.Attach(sphere_lod.VAO[i], sphere_lod.indexCount[i], GL_TRIANGLE_STRIP);
+    particle_renderer.AttachImpostors();
+
+    init_particles_position(particles);
+    particle_renderer.Upload(particles);
+
+    if (gpu_simulation_check)
+    {
+        bool agree = run_gpu_simulation_check(particle_renderer);
+        particle_renderer.Delete();
+        sphere_lod.Delete();
+        light_buffer.Delete();
+        material_buffer.Delete();
+        glfwTerminate();
+        return agree ? 0 : 1;
+    }
+
+    if (benchmark || normal_benchmark || streaming_benchmark)
+    {
+        if (benchmark)
+            run_particle_benchmark(window, ourShader, particleShader, impostorShader, particle_renderer);
+        else if (normal_benchmark)
+            run_normal_matrix_benchmark(window, particleShader, particle_renderer);
+        else
+            run_streaming_benchmark(window, impostorShader);
+        particle_renderer.Delete();
+        sphere_lod.Delete();
+        light_buffer.Delete();
+        material_buffer.Delete();
+        glfwTerminate();
+        return 0;
+    }
+
+    // the GPU random walk needs the particles in the instance buffer, so it is driven by the render loop and draws
+    // them instanced only
+    ParticleCompute* particle_compute = NULL;
+    if (gpu_simulation && (particle_collisions || particle_nbody || particle_fluid))
+    {
+        std::cout << "collisions, N-body forces and fluids are only simulated on the CPU, the particles are stepped on the CPU" << std::endl;
+        gpu_simulation = false;
+    }
+    if (gpu_simulation && !ParticleCompute::Supported())
+    {
+        std::cout << "compute shaders need OpenGL 4.3, the particles are stepped on the CPU" << std::endl;
+        gpu_simulation = false;
+    }
+    if (gpu_simulation)
+    {
+        particle_compute = new ParticleCompute("particle_step.cs");
+        particle_compute->step = particles.step;
+        simulation_thread = false;
+        if (particle_draw_mode == PARTICLES_PER_OBJECT)
+            particle_draw_mode = PARTICLES_INSTANCED;
+    }
+
+    // from here on the simulation thread owns the particles, the render loop only reads its snapshots
+    SimulationThread<ParticleStore> simulation(particles, update_particles, simulation_rate);
+    if (simulation_thread)
+        simulation.Start();
+    // without the simulation thread the render loop drives the same fixed timestep itself
+    FixedTimestep timestep(1.0 / simulation_rate);
+    ParticleStore previous_particles;
+
+    wire_cube_node.SetScale(glm::vec3(2.0f));
 
     while (!glfwWindowShouldClose(window))
     {
         processInput(window);
+        update_particle_system_node();
+        update_scene_matrices();
 
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
@@ -204,87 +574,88 @@ int main()
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        ourShader.use();
-
-        ourShader.setVec3("light.position", lightPos);
-        ourShader.setVec3("light.direction", -lightPos);
-        ourShader.setFloat("light.cutOff", glm::cos(glm::radians(12.5f)));
-        ourShader.setFloat("light.outerCutOff", glm::cos(glm::radians(17.5f)));
-        ourShader.setVec3("viewPos", camera_position);
-
-        ourShader.setVec3("light.ambient", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("light.diffuse", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-        ourShader.setFloat("light.constant", 1.0f);
-        ourShader.setFloat("light.linear", 0.09f);
-        ourShader.setFloat("light.quadratic", 0.032f);
-
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection);
-
         glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("view", view);
 
-        glm::mat4 model = glm::mat4(1.0f); 
-        ourShader.setMat4("model", model);
-
-        ourShader.setVec3("material.specular", glm::vec3(0.5f));
-        ourShader.setFloat("material.shininess", 84.0f);
-
-        ourShader.setVec3("material.ambient", glm::vec3(0.5f));
-        ourShader.setVec3("material.diffuse", glm::vec3(0.5f));
-
-        if (!init_position)
-            init_particles_position();
+        update_light_block();
 
-        for (int i = 0; i < PARTICLES_NUMBER; i++)
+        // the particles are drawn between the last two simulation steps, at the fraction of a step elapsed since the latest
+        const ParticleStore* snapshot = &particles;
+        bool instanced_particles = particle_draw_mode != PARTICLES_PER_OBJECT;
+        float interpolation;
+        if (simulation_thread)
         {
-            glm::vec3 tmp = glm::vec3(0.0f);
-
-            if (init_position)
-                tmp = move_particle(i, 0.01f);
-
-            model = glm::mat4(1.0f);
-            model = glm::rotate(model, rotation_angle_particle_system_y, glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::rotate(model, rotation_angle_particle_system_x, glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::rotate(model, rotation_angle_particle_system_z, glm::vec3(0.0f, 0.0f, 1.0f));
-            particles_position[i] += tmp;
-            model = glm::translate(model, particles_position[i]);
-            model = glm::scale(model, glm::vec3(0.005f));
-            ourShader.setMat4("model", model);
-            ourShader.setFloat("alpha", 1.0f);
-
-            renderSphere(16, 16);
+            // never waits: if no tick completed since the last frame we keep drawing the previous snapshot; a new one
+            // brings the tick before it along, however many ticks ran in between
+            if (simulation.Acquire() && instanced_particles)
+                particle_renderer.Upload(simulation.Previous(), simulation.Latest());
+            snapshot = &simulation.Latest();
+            interpolation = simulation.Alpha();
+        }
+        else
+        {
+            unsigned int steps = timestep.Advance(deltaTime);
+            for (unsigned int i = 0; i < steps && particle_compute != NULL; i++)
+            {
+                // the walk stays on the GPU; the initial positions (again after a reset with I) come from the CPU,
+                // at the step the GPU reached, as they would on the CPU path
+                if (init_position)
+                    particle_compute->Step(particle_renderer, particle_rng, PARTICLE_STEP, PARTICLE_BOX);
+                else if (!initialized)
+                {
+                    particles.step = particle_compute->step;
+                    init_particles_position(particles);
+                    particle_renderer.Upload(particles);
+                }
+            }
+            for (unsigned int i = 0; i < steps && particle_compute == NULL; i++)
+            {
+                // the state before the last step of the frame is the one the draw interpolates from
+                if (i + 1 == steps && instanced_particles)
+                    previous_particles = particles;
+                update_particles(particles);
+            }
+            if (steps > 0 && particle_compute == NULL && instanced_particles)
+                particle_renderer.Upload(previous_particles, particles);
+            interpolation = timestep.Alpha();
         }
 
-        ourShader.setVec3("material.specular", glm::vec3(0.6f, 0.7f, 0.6f));
-        ourShader.setFloat("material.shininess", 84.0f);
+        // the draws are only recorded here, in any order, and issued by the render queue at the end of the frame;
+        // the uniforms shared by all the draws of a program are set on it right away
+        render_queue.Clear();
+        if (instanced_particles)
+        {
+            bool impostors = particle_draw_mode == PARTICLES_IMPOSTOR;
+            Shader& shader = impostors ? impostorShader : particleShader;
+            unsigned int lod = select_particle_lod(projection, view);
+            particle_renderer.Select(sphere_lod.VAO[lod], sphere_lod.indexCount[lod]);
+            shader.use();
+            set_view_uniforms(shader, projection, view);
+            queue_particles_instanced(render_queue, shader, particle_renderer, view, interpolation, impostors);
+        }
 
-        ourShader.setVec3("material.ambient", glm::vec3(0.02f, 0.2f, 0.02f));
-        ourShader.setVec3("material.diffuse", glm::vec3(1.0f, 0.6f, 0.07f));
+        ourShader.use();
+        set_view_uniforms(ourShader, projection, view);
 
-        model = glm::mat4(1.0f);
-        model = glm::rotate(model, rotation_angle_particle_system_y, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, rotation_angle_particle_system_x, glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, rotation_angle_particle_system_z, glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(2.0f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("alpha", 1.0f);
+        if (!instanced_particles)
+            queue_particles_per_object(render_queue, ourShader, *snapshot, projection, view);
 
-        glBindVertexArray(cubeVAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElements(GL_LINES, 32, GL_UNSIGNED_INT, 0);
+        glm::mat4 model;
 
-        model = glm::mat4(1.0f);
-        model = glm::rotate(model, rotation_angle_particle_system_y, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, rotation_angle_particle_system_x, glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, rotation_angle_particle_system_z, glm::vec3(0.0f, 0.0f, 1.0f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("alpha", 0.5f);
+        // drawn as GL_LINES, which the polygon mode does not affect
+        render_queue.Add(ourShader, OPAQUE_STATE, RenderQueue::ViewDepth(view, glm::vec3(scene_models[WIRE_CUBE_OBJECT][3])))
+            .SetMaterial(material_buffer, CUBE_MATERIAL)
+            .SetModel(scene_models[WIRE_CUBE_OBJECT])
+            .SetNormalMatrix(scene_normals[WIRE_CUBE_OBJECT])
+            .SetAlpha(1.0f)
+            .SetElements(cubeVAO, GL_LINES, 32, GL_UNSIGNED_INT);
 
-        glBindVertexArray(cubeVAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        render_queue.Add(ourShader, TRANSPARENT_STATE, RenderQueue::ViewDepth(view, glm::vec3(scene_models[GLASS_CUBE_OBJECT][3])))
+            .SetMaterial(material_buffer, CUBE_MATERIAL)
+            .SetModel(scene_models[GLASS_CUBE_OBJECT])
+            .SetNormalMatrix(scene_normals[GLASS_CUBE_OBJECT])
+            .SetAlpha(0.5f)
+            .SetArrays(cubeVAO, GL_TRIANGLES, 0, 36);
 
         //LAMP RENDERING
         lamp_shader.use();
@@ -297,18 +668,48 @@ int main()
         model = glm::rotate(model, rotation_angle_lamp_x, glm::vec3(1.0f, 0.0f, 0.0f));
         model = glm::rotate(model, -rotation_angle_lamp_z, glm::vec3(1.0f, 0.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
-        lamp_shader.setMat4("model", model);
-
-        lamp_model.Draw(lamp_shader);
+        for (unsigned int i = 0; i < lamp_model.meshes.size(); i++)
+            render_queue.Add(lamp_shader, OPAQUE_STATE, RenderQueue::ViewDepth(view, lightPos)).SetModel(model).SetMesh(lamp_model.meshes[i]);
+
+        render_queue.Submit();
+        // the slots the particle draw read stay untouched until the GPU is done with them
+        if (instanced_particles)
+            particle_renderer.Fence();
+
+        // binds and state changes that reached the driver and that were dropped in this frame, and the draws of the queue,
+        // shown in the title once per second
+        GLStateCounters frame_calls = GlobalGLStateCounters();
+        GlobalGLStateCounters() = GLStateCounters();
+        if (currentFrame - lastTitleUpdate >= 1.0f)
+        {
+            std::ostringstream title;
+            title << "LearnOpenGL - GL calls per frame: " << frame_calls.issued << " issued, " << frame_calls.elided << " elided"
+                  << " - draws: " << render_queue.Size() << ", program switches: " << render_queue.ProgramChanges()
+                  << ", vertex array switches: " << render_queue.VertexArrayChanges()
+                  << " - simulation: " << (particle_compute != NULL ? "GPU" : "CPU");
+            glfwSetWindowTitle(window, title.str().c_str());
+            lastTitleUpdate = currentFrame;
+        }
 
         glfwSwapBuffers(window);
 
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &cubeEBO);
+    GlobalGLState().DeleteVertexArrays(1, &cubeVAO);
+    GlobalGLState().DeleteBuffers(1, &cubeVBO);
+    GlobalGLState().DeleteBuffers(1, &cubeEBO);
+
+    simulation.Stop();
+    if (particle_compute != NULL)
+    {
+        particle_compute->Delete();
+        delete particle_compute;
+    }
+    particle_renderer.Delete();
+    sphere_lod.Delete();
+    light_buffer.Delete();
+    material_buffer.Delete();
 
     glfwTerminate();
     return 0;
@@ -342,6 +743,19 @@ void processInput(GLFWwindow* window)
             initialized = false;
     }
 
+    //Inputs for cycling through the particle rendering paths (per-particle, instanced, impostor)
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE && particle_draw_mode_press)
+        particle_draw_mode_press = false;
+
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !particle_draw_mode_press)
+    {
+        particle_draw_mode_press = true;
+        particle_draw_mode = (ParticleDrawMode)((particle_draw_mode + 1) % PARTICLE_DRAW_MODES);
+        // the per-particle path needs the positions on the CPU
+        if (gpu_simulation && particle_draw_mode == PARTICLES_PER_OBJECT)
+            particle_draw_mode = PARTICLES_INSTANCED;
+    }
+
     //Inputs for handling the light movement (Forward, Backward)
 
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
@@ -408,130 +822,868 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-void init_particles_position()
+void init_particles_position(ParticleStore& store)
 {
     if (!initialized)
     {
-        for (int i = 0; i < particles_position.size(); i++)
+        if (particle_fluid)
+            particle_fluid_system.InitDamBreak(store, PARTICLE_BOX);
+        else
+            InitParticlesUniform(store, particle_rng, PARTICLE_INIT_BOX);
+        if (particle_nbody)
+            particle_nbody_system.Reset(store);
+        initialized = true;
+    }
+}
+
+// one simulation tick: the particles stay at their initial position until the random walk is switched on (I)
+void update_particles(ParticleStore& store)
+{
+    if (!init_position)
+    {
+        init_particles_position(store);
+        return;
+    }
+
+    step_particles(store, *particle_pool);
+}
+
+// one simulation step of every particle on the thread pool: a step of the fluid, of the N-body forces or of the
+// hard-sphere walk when that mode is on (main keeps at most one), otherwise a random walk step split in cache-line
+// aligned chunks. The random numbers of both walks only depend on (seed, particle, step), so the walks are the
+// same for any number of threads.
+void step_particles(ParticleStore& store, ThreadPool& pool)
+{
+    if (particle_fluid)
+    {
+        particle_fluid_system.Step(store, pool, PARTICLE_BOX);
+        return;
+    }
+    if (particle_nbody)
+    {
+        particle_nbody_system.Step(store, pool, PARTICLE_BOX);
+        return;
+    }
+    if (particle_collisions)
+    {
+        particle_collider.Step(store, particle_rng, pool, PARTICLE_STEP, PARTICLE_BOX, PARTICLE_SCALE);
+        return;
+    }
+
+    uint64_t step = store.step;
+    pool.ParallelFor(store.Size(), PARTICLES_PER_CHUNK, [&store, step](std::size_t first, std::size_t last)
+    {
+        RandomWalkStepRange(store, first, last, step, particle_rng, PARTICLE_STEP, PARTICLE_BOX);
+    });
+    store.step++;
+}
+
+// steps a large particle system with 1, 2, 4, ... threads, printing the time per step and checking that
+// every thread count produces bitwise the same particles
+void run_thread_benchmark(unsigned int max_threads)
+{
+    const unsigned int STEPS = 50;
+    std::size_t count = particles.Size() > PARTICLES_NUMBER ? particles.Size() : 4000000;
+
+    if (max_threads == 0)
+        max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0)
+        max_threads = 1;
+
+    std::cout << count << " particles, " << STEPS << " steps" << std::endl;
+    std::cout << "threads   ms/step   speedup   identical" << std::endl;
+
+    ParticleStore reference;
+    double single_ms = 0.0;
+    for (unsigned int threads = 1; ; threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2)
+    {
+        ThreadPool pool(threads);
+        ParticleStore store(count);
+        InitParticlesUniform(store, particle_rng, PARTICLE_INIT_BOX);
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int s = 0; s < STEPS; s++)
+            step_particles(store, pool);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / STEPS;
+
+        bool identical = true;
+        if (threads == 1)
         {
-            glm::vec3 tmp = glm::vec3(0.1f);
-            for (int j = 0; j < 3; j++)
-            {
-                float a = 0.19;
-                float random = ((float)rand()) / (float)RAND_MAX;
-                float r = random * a;
+            reference = store;
+            single_ms = ms;
+        }
+        else
+        {
+            identical = std::memcmp(store.x.data(), reference.x.data(), count * sizeof(float)) == 0 &&
+                        std::memcmp(store.y.data(), reference.y.data(), count * sizeof(float)) == 0 &&
+                        std::memcmp(store.z.data(), reference.z.data(), count * sizeof(float)) == 0;
+        }
+
+        std::cout << threads << "\t  " << ms << "\t    " << single_ms / ms << "x\t" << (identical ? "yes" : "NO") << std::endl;
+
+        if (threads >= max_threads)
+            break;
+    }
+}
+
+// walks hard-sphere particles spread over the whole box with 1, 2, 4, ... threads, printing the time per step spent
+// building the grid and moving the particles, and checking that every thread count walks them the same way; the
+// overlapping pairs found through the grid are checked once against an O(N^2) count on a smaller system
+void run_collision_benchmark(unsigned int max_threads)
+{
+    const unsigned int STEPS = 20;
+    const std::size_t BRUTE_FORCE_COUNT = 20000;
+    std::size_t count = particles.Size() > PARTICLES_NUMBER ? particles.Size() : 100000;
 
-                float negate = (std::rand() % 2 == 0) ? -1 : 1;
+    if (max_threads == 0)
+        max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0)
+        max_threads = 1;
 
-                tmp[j] = r * negate;
+    {
+        ThreadPool pool(max_threads);
+        ParticleStore store(BRUTE_FORCE_COUNT);
+        InitParticlesUniform(store, particle_rng, PARTICLE_BOX);
+        const float contact2 = 4.0f * PARTICLE_SCALE * PARTICLE_SCALE;
+        std::size_t brute_force = 0;
+        for (std::size_t i = 0; i < BRUTE_FORCE_COUNT; i++)
+        {
+            for (std::size_t j = i + 1; j < BRUTE_FORCE_COUNT; j++)
+            {
+                float dx = store.x[j] - store.x[i], dy = store.y[j] - store.y[i], dz = store.z[j] - store.z[i];
+                if (dx * dx + dy * dy + dz * dz < contact2)
+                    brute_force++;
             }
+        }
+        ParticleCollisions collisions;
+        std::size_t grid = collisions.Overlaps(store, pool, PARTICLE_BOX, PARTICLE_SCALE);
+        std::cout << BRUTE_FORCE_COUNT << " particles, overlapping pairs: " << grid << " with the grid, "
+                  << brute_force << " with O(N^2) " << (grid == brute_force ? "(same)" : "(DIFFERENT)") << std::endl;
+    }
+
+    std::cout << count << " particles, " << STEPS << " steps" << std::endl;
+    std::cout << "threads   build ms/step   move ms/step   rejected/step   overlaps before   after   identical" << std::endl;
+
+    ParticleStore reference;
+    for (unsigned int threads = 1; ; threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2)
+    {
+        ThreadPool pool(threads);
+        ParticleStore store(count);
+        InitParticlesUniform(store, particle_rng, PARTICLE_BOX);
+        ParticleCollisions collisions;
+        std::size_t before = collisions.Overlaps(store, pool, PARTICLE_BOX, PARTICLE_SCALE);
+
+        double build = 0.0, move = 0.0;
+        std::size_t rejected = 0;
+        for (unsigned int s = 0; s < STEPS; s++)
+        {
+            collisions.Step(store, particle_rng, pool, PARTICLE_STEP, PARTICLE_BOX, PARTICLE_SCALE);
+            build += collisions.buildSeconds;
+            move += collisions.moveSeconds;
+            rejected += collisions.rejected;
+        }
+        std::size_t after = collisions.Overlaps(store, pool, PARTICLE_BOX, PARTICLE_SCALE);
 
-            particles_position[i] = tmp;
-            initialized = true;
+        bool identical = true;
+        if (threads == 1)
+            reference = store;
+        else
+        {
+            identical = std::memcmp(store.x.data(), reference.x.data(), count * sizeof(float)) == 0 &&
+                        std::memcmp(store.y.data(), reference.y.data(), count * sizeof(float)) == 0 &&
+                        std::memcmp(store.z.data(), reference.z.data(), count * sizeof(float)) == 0;
         }
+
+        std::cout << threads << "\t  " << build * 1000.0 / STEPS << "\t\t  " << move * 1000.0 / STEPS << "\t\t "
+                  << rejected / STEPS << "\t\t " << before << "\t\t   " << after << "\t   " << (identical ? "yes" : "NO") << std::endl;
+
+        if (threads >= max_threads)
+            break;
     }
 }
 
-glm::vec3 move_particle(int particle_number, float unit)
+// Barnes-Hut against the direct O(N^2) sum: for a few system sizes and opening angles, the time to build the tree
+// and to compute the forces, and the RMS error of the accelerations relative to their RMS; then the relative energy
+// drift of a cold collapse integrated with either
+void run_nbody_benchmark(unsigned int threads)
 {
-    glm::vec3 tmp = glm::vec3(0.0f);
+    const float thetas[] = { 0.3f, 0.5f, 0.7f, 1.0f };
+    const std::size_t counts[] = { 2000, 8000, 32000 };
+    const std::size_t DRIFT_COUNT = 4000;
+    const unsigned int DRIFT_STEPS = 300;
+
+    ThreadPool pool(threads);
+    std::cout << pool.Size() << " threads" << std::endl;
+    std::cout << "particles   theta   build ms   force ms   direct ms   rms error" << std::endl;
+    for (std::size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        const std::size_t count = counts[c];
+        ParticleStore store(count);
+        InitParticlesUniform(store, particle_rng, PARTICLE_INIT_BOX);
+        NBodySystem system(particle_nbody_system.coupling, NBODY_SOFTENING, NBODY_THETA, NBODY_TIME_STEP);
+
+        std::vector<float> reference[3] = { std::vector<float>(count), std::vector<float>(count), std::vector<float>(count) };
+        auto start = std::chrono::steady_clock::now();
+        system.DirectAccelerations(store, pool, reference[0].data(), reference[1].data(), reference[2].data());
+        double direct_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        for (std::size_t t = 0; t < sizeof(thetas) / sizeof(thetas[0]); t++)
+        {
+            system.theta = thetas[t];
+            system.buildSeconds = system.forceSeconds = 0.0;
+            system.ComputeAccelerations(store, pool, PARTICLE_BOX);
+
+            const float* tree[3] = { system.AccelerationX(), system.AccelerationY(), system.AccelerationZ() };
+            double error = 0.0, norm = 0.0;
+            for (int j = 0; j < 3; j++)
+            {
+                for (std::size_t i = 0; i < count; i++)
+                {
+                    double e = (double)tree[j][i] - reference[j][i];
+                    error += e * e;
+                    norm += (double)reference[j][i] * reference[j][i];
+                }
+            }
+            std::cout << count << "\t    " << thetas[t] << "\t    " << system.buildSeconds * 1000.0 << "\t"
+                      << system.forceSeconds * 1000.0 << "\t  " << direct_ms << "\t      " << std::sqrt(error / norm) << std::endl;
+        }
+    }
+
+    std::cout << DRIFT_COUNT << " particles, " << DRIFT_STEPS << " steps of " << NBODY_TIME_STEP << std::endl;
+    std::cout << "forces        theta   ms/step   energy drift" << std::endl;
+    for (int direct = 1; direct >= 0; direct--)
+    {
+        ParticleStore store(DRIFT_COUNT);
+        InitParticlesUniform(store, particle_rng, PARTICLE_INIT_BOX);
+        NBodySystem system(particle_nbody_system.coupling, NBODY_SOFTENING, particle_nbody_system.theta, NBODY_TIME_STEP);
+        system.direct = direct != 0;
+        system.Reset(store);
+
+        double initial = system.Energy(store, pool);
+        double seconds = 0.0;
+        for (unsigned int s = 0; s < DRIFT_STEPS; s++)
+        {
+            system.Step(store, pool, PARTICLE_BOX);
+            seconds += system.buildSeconds + system.forceSeconds + system.integrateSeconds;
+        }
+        double drift = (system.Energy(store, pool) - initial) / std::abs(initial);
+        std::cout << (direct ? "direct" : "Barnes-Hut") << "\t      " << (direct ? 0.0f : system.theta) << "\t    "
+                  << seconds * 1000.0 / DRIFT_STEPS << "\t      " << drift << std::endl;
+    }
+}
 
-    for (int j = 0; j < 3; j++)
+// steps a breaking dam of a few fluid sizes with 1, 2, 4, ... threads, printing the time per step of the neighbor
+// search (grid and neighbor lists), the density and pressure solve, the forces and the integration, the speedup
+// over one thread, and how far the density strays from rest
+void run_sph_benchmark(unsigned int max_threads)
+{
+    const unsigned int WARMUP_STEPS = 10;
+    const unsigned int STEPS = 50;
+    std::vector<std::size_t> counts;
+    if (particles.Size() > PARTICLES_NUMBER)
+        counts.push_back(particles.Size());
+    else
     {
-        float negate = (std::rand() % 2 == 0) ? -1 : 1;
+        counts.push_back(25000);
+        counts.push_back(100000);
+    }
+    if (max_threads == 0)
+        max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0)
+        max_threads = 1;
+
+    std::cout << STEPS << " steps" << std::endl;
+    std::cout << "particles   threads   neighbors/particle   neighbor ms   density ms   force ms   integrate ms   steps/s   speedup   density error" << std::endl;
+    for (std::size_t c = 0; c < counts.size(); c++)
+    {
+        double single = 0.0;
+        for (unsigned int threads = 1; ; threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2)
+        {
+            ThreadPool pool(threads);
+            ParticleStore store(counts[c]);
+            SphFluid fluid;
+            fluid.InitDamBreak(store, PARTICLE_BOX);
+            for (unsigned int s = 0; s < WARMUP_STEPS; s++)
+                fluid.Step(store, pool, PARTICLE_BOX);
+
+            double neighbor = 0.0, density = 0.0, force = 0.0, integrate = 0.0;
+            for (unsigned int s = 0; s < STEPS; s++)
+            {
+                fluid.Step(store, pool, PARTICLE_BOX);
+                neighbor += fluid.neighborSeconds;
+                density += fluid.densitySeconds;
+                force += fluid.forceSeconds;
+                integrate += fluid.integrateSeconds;
+            }
+            double total = neighbor + density + force + integrate;
+            if (threads == 1)
+                single = total;
+            std::cout << counts[c] << "\t    " << threads << "\t      " << fluid.AverageNeighbors() << "\t\t   " << neighbor * 1000.0 / STEPS
+                      << "\t " << density * 1000.0 / STEPS << "\t      " << force * 1000.0 / STEPS << "\t " << integrate * 1000.0 / STEPS
+                      << "\t\t" << STEPS / total << "\t" << single / total << "x\t" << fluid.DensityError() << std::endl;
+
+            if (threads >= max_threads)
+                break;
+        }
+    }
+}
 
-        unit = 0.01 * negate;
+// the spotlight follows the lamp and points at the origin; one buffer update serves every program
+void update_light_block()
+{
+    LightBlock light;
+    light.position = lightPos;
+    light.direction = -lightPos;
+    light.cutOff = glm::cos(glm::radians(12.5f));
+    light.outerCutOff = glm::cos(glm::radians(17.5f));
+
+    light.ambient = glm::vec3(1.0f, 1.0f, 1.0f);
+    light.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+    light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    light.constant = 1.0f;
+    light.linear = 0.09f;
+    light.quadratic = 0.032f;
+
+    light_buffer.Update(0, light);
+}
 
-        glm::vec3 next;
-        next[j] = particles_position[particle_number][j] + unit;
+void set_view_uniforms(Shader& shader, const glm::mat4& projection, const glm::mat4& view)
+{
+    shader.setVec3("viewPos", camera_position);
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+}
 
-        tmp[j] = (next[j] < -0.4f || next[j] > 0.4f) ? 0.0f : unit;
+// reference path: one model matrix, one alpha and one draw call per particle, always at the latest simulation step;
+// every particle picks its own level of detail. A particle only adds an offset and a uniform scale to the particle
+// system transform, which change the length of the normals but not their direction, so they share its normal matrix
+void queue_particles_per_object(RenderQueue& queue, Shader& shader, const ParticleStore& store, const glm::mat4& projection, const glm::mat4& view)
+{
+    // the positions are already split in x, y and z arrays, all the model matrices are built in one batch
+    particle_transforms.Resize(store.Size());
+    particle_models.resize(store.Size());
+    std::copy(store.x.begin(), store.x.end(), particle_transforms.px.begin());
+    std::copy(store.y.begin(), store.y.end(), particle_transforms.py.begin());
+    std::copy(store.z.begin(), store.z.end(), particle_transforms.pz.begin());
+    std::fill(particle_transforms.sx.begin(), particle_transforms.sx.end(), PARTICLE_SCALE);
+    std::fill(particle_transforms.sy.begin(), particle_transforms.sy.end(), PARTICLE_SCALE);
+    std::fill(particle_transforms.sz.begin(), particle_transforms.sz.end(), PARTICLE_SCALE);
+    particle_transforms.Compute(scene_models[PARTICLE_SYSTEM_OBJECT], particle_models.data(), NULL);
+
+    // the queue groups the particles by level of detail, so the sphere vertex arrays are bound once each
+    for (std::size_t i = 0; i < store.Size(); i++)
+    {
+        const glm::mat4& model = particle_models[i];
+        glm::vec3 position(model[3]);
+        unsigned int level = sphere_lod.SelectLevel(position, PARTICLE_SCALE, view, projection, (float)SCR_HEIGHT);
+        queue.Add(shader, OPAQUE_STATE, RenderQueue::ViewDepth(view, position))
+            .SetMaterial(material_buffer, PARTICLE_MATERIAL)
+            .SetModel(model)
+            .SetNormalMatrix(scene_normals[PARTICLE_SYSTEM_OBJECT])
+            .SetAlpha(1.0f)
+            .SetElements(sphere_lod.VAO[level], GL_TRIANGLE_STRIP, sphere_lod.indexCount[level], GL_UNSIGNED_INT);
     }
+}
+
+// rotates the particle system by the angles set with the keyboard, in the y, x, z order
+void update_particle_system_node()
+{
+    glm::quat rotation = glm::angleAxis(rotation_angle_particle_system_y, glm::vec3(0.0f, 1.0f, 0.0f))
+                       * glm::angleAxis(rotation_angle_particle_system_x, glm::vec3(1.0f, 0.0f, 0.0f))
+                       * glm::angleAxis(rotation_angle_particle_system_z, glm::vec3(0.0f, 0.0f, 1.0f));
+    particle_system_node.SetRotation(rotation);
+}
+
+// the world matrices of the scene nodes, read by every draw of the frame, and their normal matrices
+void update_scene_matrices()
+{
+    scene_models[PARTICLE_SYSTEM_OBJECT] = particle_system_node.World();
+    scene_models[WIRE_CUBE_OBJECT] = wire_cube_node.World();
+    scene_models[GLASS_CUBE_OBJECT] = glass_cube_node.World();
+    NormalMatrices(scene_models, scene_normals, SCENE_OBJECTS);
+}
+
+// the instanced draw shares one mesh between all the particles, so its level of detail is the one
+// of a particle at the point of the box nearest to the camera
+unsigned int select_particle_lod(const glm::mat4& projection, const glm::mat4& view)
+{
+    // however the particle system is rotated, its particles stay within sqrt(3) * PARTICLE_BOX of its center
+    glm::vec3 nearest = glm::normalize(camera_position) * std::sqrt(3.0f) * PARTICLE_BOX;
+    return sphere_lod.SelectLevel(nearest, PARTICLE_SCALE, view, projection, (float)SCR_HEIGHT);
+}
 
-    return tmp;
+// instanced path: the particle system transform is shared, the positions come from the instance buffer
+// and are interpolated between the last two uploaded states (0 draws the previous one, 1 the latest);
+// impostors draws a ray-cast quad per particle instead of the sphere mesh
+void queue_particles_instanced(RenderQueue& queue, Shader& shader, const ParticleRenderer& renderer, const glm::mat4& view, float interpolation, bool impostors)
+{
+    if (renderer.Instances() == 0)
+        return;
+
+    shader.use();
+    shader.setFloat("particleScale", PARTICLE_SCALE);
+    shader.setFloat("interpolation", interpolation);
+
+    RenderCommand& command = queue.Add(shader, OPAQUE_STATE, RenderQueue::ViewDepth(view, glm::vec3(scene_models[PARTICLE_SYSTEM_OBJECT][3])))
+        .SetMaterial(material_buffer, PARTICLE_MATERIAL)
+        .SetModel(scene_models[PARTICLE_SYSTEM_OBJECT])
+        .SetNormalMatrix(scene_normals[PARTICLE_SYSTEM_OBJECT])
+        .SetAlpha(1.0f);
+    if (impostors)
+        command.SetArrays(renderer.ImpostorVertexArray(), GL_TRIANGLE_STRIP, 0, 4, renderer.Instances());
+    else
+        command.SetElements(renderer.VertexArray(), renderer.Mode(), renderer.IndexCount(), GL_UNSIGNED_INT, renderer.Instances());
 }
 
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
-void renderSphere(unsigned int X_SEGMENTS, unsigned int Y_SEGMENTS)
+// renders the moving particle system with every path at 2k, 20k, 200k and 2M particles and prints the average frame time;
+// the per-particle path is skipped above 200k, where a frame takes seconds
+void run_particle_benchmark(GLFWwindow* window, Shader& ourShader, Shader& particleShader, Shader& impostorShader, ParticleRenderer& renderer)
 {
-    if (sphereVAO == 0)
+    const unsigned int counts[] = { 2000, 20000, 200000, 2000000 };
+    const unsigned int PER_OBJECT_LIMIT = 200000;
+    const int WARMUP_FRAMES = 5;
+    const double MEASURE_SECONDS = 2.0;
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    update_light_block();
+    update_scene_matrices();
+
+    std::cout << "particles   per-particle (ms)   instanced (ms)   impostor (ms)   impostor vs instanced" << std::endl;
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
     {
-        glGenVertexArrays(1, &sphereVAO);
+        particles.Resize(counts[c]);
+        initialized = false;
+        init_particles_position(particles);
+        init_position = true;
+
+        double frame_ms[PARTICLE_DRAW_MODES] = { 0.0 };
+        for (int path = 0; path < PARTICLE_DRAW_MODES; path++)
+        {
+            if (path == PARTICLES_PER_OBJECT && counts[c] > PER_OBJECT_LIMIT)
+                continue;
+
+            Shader& shader = path == PARTICLES_PER_OBJECT ? ourShader : (path == PARTICLES_INSTANCED ? particleShader : impostorShader);
+            shader.use();
+            set_view_uniforms(shader, projection, view);
+
+            int frames = 0;
+            double start = 0.0;
+            while (!glfwWindowShouldClose(window))
+            {
+                if (frames == WARMUP_FRAMES)
+                {
+                    // make sure the warm-up frames are out of the pipeline before starting the clock
+                    glFinish();
+                    start = glfwGetTime();
+                }
 
-        unsigned int vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                update_particles(particles);
+                render_queue.Clear();
+                if (path == PARTICLES_PER_OBJECT)
+                    queue_particles_per_object(render_queue, shader, particles, projection, view);
+                else
+                {
+                    unsigned int lod = select_particle_lod(projection, view);
+                    renderer.Select(sphere_lod.VAO[lod], sphere_lod.indexCount[lod]);
+                    renderer.Upload(particles);
+                    queue_particles_instanced(render_queue, shader, renderer, view, 1.0f, path == PARTICLES_IMPOSTOR);
+                }
+                render_queue.Submit();
+                renderer.Fence();
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+                frames++;
+
+                if (frames > WARMUP_FRAMES && glfwGetTime() - start >= MEASURE_SECONDS)
+                    break;
+            }
+            glFinish();
+            frame_ms[path] = frames > WARMUP_FRAMES ? (glfwGetTime() - start) * 1000.0 / (frames - WARMUP_FRAMES) : 0.0;
+        }
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec3> normals;
-        std::vector<unsigned int> indices;
+        std::cout << counts[c] << "\t    ";
+        if (frame_ms[PARTICLES_PER_OBJECT] > 0.0)
+            std::cout << frame_ms[PARTICLES_PER_OBJECT];
+        else
+            std::cout << "-";
+        std::cout << "\t\t" << frame_ms[PARTICLES_INSTANCED] << "\t\t " << frame_ms[PARTICLES_IMPOSTOR] << "\t\t "
+                  << frame_ms[PARTICLES_INSTANCED] / frame_ms[PARTICLES_IMPOSTOR] << "x" << std::endl;
+    }
+}
 
-        const float PI = 3.14159265359;
-        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+// normal matrices of 1M random translate-rotate-scale matrices with glm's general inverse, NormalMatricesScalar and
+// NormalMatrices; then the instanced particles at the finest level of detail with rasterization disabled, so that
+// the frame is all vertex shading, once with the inverse computed per vertex and once with the uniform normal matrix
+void run_normal_matrix_benchmark(GLFWwindow* window, Shader& particleShader, ParticleRenderer& renderer)
+{
+    const std::size_t MATRICES = 1000000;
+    const int CPU_RUNS = 5;
+    const unsigned int GPU_PARTICLES = 20000;
+    const int WARMUP_FRAMES = 5;
+    const double MEASURE_SECONDS = 2.0;
+
+    std::vector<glm::mat4> models(MATRICES);
+    for (std::size_t i = 0; i < MATRICES; i++)
+    {
+        uint32_t bits[8];
+        particle_rng.Generate((uint32_t)i, 0, 0, bits);
+        particle_rng.Generate((uint32_t)i, 0, 1, bits + 4);
+        float r[8];
+        for (int k = 0; k < 8; k++)
+            r[k] = bits[k] * (1.0f / 4294967296.0f);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(r[0], r[1], r[2]) * 2.0f - 1.0f);
+        model = glm::rotate(model, r[3] * 6.2831853f, glm::vec3(r[4] - 0.5f, r[5] - 0.5f, r[6] + 0.1f));
+        models[i] = glm::scale(model, glm::vec3(0.5f + r[7], 0.5f + r[0], 0.5f + r[5]));
+    }
+
+    std::vector<glm::mat3> reference(MATRICES), normals(MATRICES);
+    const char* names[] = { "glm inverse", "scalar", "batched" };
+    std::cout << MATRICES << " normal matrices" << std::endl;
+    std::cout << "method        ns/matrix   max error" << std::endl;
+    for (int method = 0; method < 3; method++)
+    {
+        std::vector<glm::mat3>& out = method == 0 ? reference : normals;
+        double best = 0.0;
+        for (int run = 0; run < CPU_RUNS; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (method == 0)
+            {
+                for (std::size_t i = 0; i < MATRICES; i++)
+                    out[i] = glm::mat3(glm::transpose(glm::inverse(models[i])));
+            }
+            else if (method == 1)
+                NormalMatricesScalar(models.data(), out.data(), MATRICES);
+            else
+                NormalMatrices(models.data(), out.data(), MATRICES);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / MATRICES;
+            if (run == 0 || ns < best)
+                best = ns;
+        }
+
+        float error = 0.0f;
+        for (std::size_t i = 0; method > 0 && i < MATRICES; i++)
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    error = std::max(error, std::abs(out[i][c][r] - reference[i][c][r]));
+        std::cout << names[method] << "\t      " << best << "\t  " << error << std::endl;
+    }
+
+    Shader inverseShader("particle_instanced_inverse.vs", "light_casters.fs");
+    BindUniformBlock(inverseShader.ID, "LightBlock", LIGHT_BLOCK_BINDING);
+    BindUniformBlock(inverseShader.ID, "MaterialBlock", MATERIAL_BLOCK_BINDING);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    update_light_block();
+    update_scene_matrices();
+
+    particles.Resize(GPU_PARTICLES);
+    initialized = false;
+    init_particles_position(particles);
+    renderer.Upload(particles);
+    const unsigned int lod = SphereLod::LEVELS - 1;
+    renderer.Select(sphere_lod.VAO[lod], sphere_lod.indexCount[lod]);
+
+    std::cout << GPU_PARTICLES << " particles, " << (unsigned long long)GPU_PARTICLES * sphere_lod.indexCount[lod]
+              << " vertices per frame" << std::endl;
+    std::cout << "normal matrix   ms/frame" << std::endl;
+    glEnable(GL_RASTERIZER_DISCARD);
+    Shader* shaders[] = { &inverseShader, &particleShader };
+    const char* shader_names[] = { "per vertex", "uniform" };
+    double frame_ms[2] = { 0.0 };
+    for (int s = 0; s < 2; s++)
+    {
+        shaders[s]->use();
+        set_view_uniforms(*shaders[s], projection, view);
+
+        int frames = 0;
+        double start = 0.0;
+        while (!glfwWindowShouldClose(window))
         {
-            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+            if (frames == WARMUP_FRAMES)
+            {
+                glFinish();
+                start = glfwGetTime();
+            }
+            render_queue.Clear();
+            queue_particles_instanced(render_queue, *shaders[s], renderer, view, 1.0f, false);
+            render_queue.Submit();
+            glfwPollEvents();
+            frames++;
+
+            if (frames > WARMUP_FRAMES && glfwGetTime() - start >= MEASURE_SECONDS)
             {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
+                glFinish();
+                break;
             }
         }
+        frame_ms[s] = frames > WARMUP_FRAMES ? (glfwGetTime() - start) * 1000.0 / (frames - WARMUP_FRAMES) : 0.0;
+        std::cout << shader_names[s] << "\t\t" << frame_ms[s] << std::endl;
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+    std::cout << "speedup " << frame_ms[0] / frame_ms[1] << "x" << std::endl;
+    GlobalGLState().DeleteProgram(inverseShader.ID);
+}
+
+// model and normal matrices of 1k to 1M random objects: the glm chain SceneNode and the exercises used before
+// (translate * mat4_cast * scale, then the inverse transpose), the scalar TransformBatch path and the vector one
+void run_transform_benchmark()
+{
+    const std::size_t counts[] = { 1000, 10000, 100000, 1000000 };
+    // objects transformed per measure, whatever the batch size
+    const std::size_t WORK = 4000000;
+
+    std::cout << "objects   glm (ns)   scalar (ns)   batched (ns)   batched vs glm   max error" << std::endl;
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        const std::size_t count = counts[c];
+        const std::size_t runs = std::max<std::size_t>(1, WORK / count);
+
+        TransformBatch batch(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            uint32_t bits[8];
+            particle_rng.Generate((uint32_t)i, 0, 0, bits);
+            particle_rng.Generate((uint32_t)i, 0, 1, bits + 4);
+            float r[8];
+            for (int k = 0; k < 8; k++)
+                r[k] = bits[k] * (1.0f / 4294967296.0f);
+
+            glm::quat rotation = glm::angleAxis(r[3] * 6.2831853f, glm::normalize(glm::vec3(r[4] - 0.5f, r[5] - 0.5f, r[6] + 0.1f)));
+            batch.Set(i, glm::vec3(r[0], r[1], r[2]) * 2.0f - 1.0f, rotation, glm::vec3(0.5f + r[7], 0.5f + r[0], 0.5f + r[5]));
+        }
 
-        bool oddRow = false;
-        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+        std::vector<glm::mat4> reference_models(count), models(count);
+        std::vector<glm::mat3> reference_normals(count), normals(count);
+        double ns[3];
+        for (int method = 0; method < 3; method++)
         {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t run = 0; run < runs; run++)
             {
-                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+                if (method == 0)
                 {
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        glm::quat rotation(batch.qw[i], batch.qx[i], batch.qy[i], batch.qz[i]);
+                        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(batch.px[i], batch.py[i], batch.pz[i]));
+                        model = model * glm::mat4_cast(rotation);
+                        model = glm::scale(model, glm::vec3(batch.sx[i], batch.sy[i], batch.sz[i]));
+                        reference_models[i] = model;
+                        reference_normals[i] = glm::mat3(glm::transpose(glm::inverse(model)));
+                    }
                 }
+                else if (method == 1)
+                    batch.ComputeScalar(0, count, glm::mat4(1.0f), models.data(), normals.data());
+                else
+                    batch.Compute(models.data(), normals.data());
             }
-            else
+            ns[method] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (runs * count);
+        }
+
+        float error = 0.0f;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            for (int k = 0; k < 4; k++)
+                for (int r = 0; r < 4; r++)
+                    error = std::max(error, std::abs(models[i][k][r] - reference_models[i][k][r]));
+            for (int k = 0; k < 3; k++)
+                for (int r = 0; r < 3; r++)
+                    error = std::max(error, std::abs(normals[i][k][r] - reference_normals[i][k][r]));
+        }
+
+        std::cout << count << "\t  " << ns[0] << "\t     " << ns[1] << "\t   " << ns[2] << "\t  "
+                  << ns[0] / ns[2] << "x\t   " << error << std::endl;
+    }
+}
+
+// streams the positions of 2k to 2M moving particles every frame with each StreamingBuffer strategy and draws them as
+// impostors straight from the streamed region, so that the GPU reads what was just written; prints the CPU time spent
+// uploading (and, for the persistent buffer, waiting on fences) per frame and the upload bandwidth it amounts to
+void run_streaming_benchmark(GLFWwindow* window, Shader& impostorShader)
+{
+    const unsigned int counts[] = { 2000, 20000, 200000, 2000000 };
+    const int WARMUP_FRAMES = 5;
+    const double MEASURE_SECONDS = 2.0;
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    update_light_block();
+    update_scene_matrices();
+
+    impostorShader.use();
+    set_view_uniforms(impostorShader, projection, view);
+    impostorShader.setMat4("model", scene_models[PARTICLE_SYSTEM_OBJECT]);
+    impostorShader.setMat3("normalMatrix", scene_normals[PARTICLE_SYSTEM_OBJECT]);
+    impostorShader.setFloat("particleScale", PARTICLE_SCALE);
+    impostorShader.setFloat("interpolation", 1.0f);
+    impostorShader.setFloat("alpha", 1.0f);
+    material_buffer.Bind(PARTICLE_MATERIAL);
+    GlobalGLState().Apply(OPAQUE_STATE);
+
+    // the impostor quads need no vertex attribute, only the streamed offsets (the previous state is the same)
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    GlobalGLState().BindVertexArray(vao);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        glEnableVertexAttribArray(ParticleRenderer::OFFSET_ATTRIBUTE + i);
+        glEnableVertexAttribArray(ParticleRenderer::PREVIOUS_ATTRIBUTE + i);
+        glVertexAttribDivisor(ParticleRenderer::OFFSET_ATTRIBUTE + i, 1);
+        glVertexAttribDivisor(ParticleRenderer::PREVIOUS_ATTRIBUTE + i, 1);
+    }
+
+    std::cout << "particles   strategy     upload (ms/frame)   stall (ms/frame)   bandwidth (GB/s)   frame (ms)" << std::endl;
+    std::vector<float> planes;
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        particles.Resize(counts[c]);
+        initialized = false;
+        init_particles_position(particles);
+        init_position = true;
+        planes.resize(3 * (std::size_t)counts[c]);
+
+        for (int strategy = 0; strategy < STREAMING_STRATEGIES; strategy++)
+        {
+            if (!StreamingBuffer::Supported((StreamingStrategy)strategy))
+            {
+                std::cout << counts[c] << "\t    " << StreamingBuffer::Name((StreamingStrategy)strategy) << "\t not supported" << std::endl;
+                continue;
+            }
+            StreamingBuffer stream;
+            stream.Create(GL_ARRAY_BUFFER, planes.size() * sizeof(float), (StreamingStrategy)strategy);
+
+            int frames = 0;
+            double start = 0.0;
+            while (!glfwWindowShouldClose(window))
             {
-                for (int x = X_SEGMENTS; x >= 0; --x)
+                if (frames == WARMUP_FRAMES)
+                {
+                    glFinish();
+                    start = glfwGetTime();
+                    StreamingBuffer::Counters() = StreamingCounters();
+                }
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                update_particles(particles);
+                std::copy(particles.x.begin(), particles.x.end(), planes.begin());
+                std::copy(particles.y.begin(), particles.y.end(), planes.begin() + counts[c]);
+                std::copy(particles.z.begin(), particles.z.end(), planes.begin() + 2 * (std::size_t)counts[c]);
+
+                GLintptr offset = stream.Write(&planes[0], planes.size() * sizeof(float));
+                GlobalGLState().BindVertexArray(vao);
+                for (unsigned int i = 0; i < 3; i++)
                 {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
+                    void* plane = (void*)(offset + i * (GLintptr)counts[c] * sizeof(float));
+                    glVertexAttribPointer(ParticleRenderer::OFFSET_ATTRIBUTE + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), plane);
+                    glVertexAttribPointer(ParticleRenderer::PREVIOUS_ATTRIBUTE + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), plane);
                 }
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, counts[c]);
+                stream.Fence();
+
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+                frames++;
+
+                if (frames > WARMUP_FRAMES && glfwGetTime() - start >= MEASURE_SECONDS)
+                    break;
+            }
+            glFinish();
+            const int measured = frames - WARMUP_FRAMES;
+            if (measured > 0)
+            {
+                const StreamingCounters& counters = StreamingBuffer::Counters();
+                std::cout << counts[c] << "\t    " << StreamingBuffer::Name((StreamingStrategy)strategy) << "\t "
+                          << counters.uploadSeconds * 1000.0 / measured << "\t\t\t "
+                          << counters.stallSeconds * 1000.0 / measured << "\t\t    "
+                          << counters.bytes / counters.uploadSeconds / 1e9 << "\t\t       "
+                          << (glfwGetTime() - start) * 1000.0 / measured << std::endl;
             }
-            oddRow = !oddRow;
+            stream.Delete();
         }
-        indexCount = indices.size();
+    }
+    GlobalGLState().DeleteVertexArrays(1, &vao);
+}
 
-        std::vector<float> data;
-        for (unsigned int i = 0; i < positions.size(); ++i)
-        {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
+// walks the same particles on the CPU and in the compute shader from the same initial positions, and compares the
+// two: how many particles ended up bitwise the same, and per axis the mean and spread of the positions and the
+// share of particles at a wall. Both run the same generator on the same counters, so an IEEE-conforming GPU matches
+// bit for bit; the statistics are what has to agree on any GPU (a two-sample test on the means, 5 sigma).
+// Runs headless on Mesa's llvmpipe (LIBGL_ALWAYS_SOFTWARE=1). Returns true if the backends agree.
+bool run_gpu_simulation_check(ParticleRenderer& renderer)
+{
+    const std::size_t COUNT = 100000;
+    const int STEPS = 500;
 
-            if (normals.size() > 0)
+    if (!ParticleCompute::Supported())
+    {
+        std::cout << "compute shaders need OpenGL 4.3, nothing to check" << std::endl;
+        return false;
+    }
+
+    ParticleStore cpu(COUNT);
+    InitParticlesUniform(cpu, particle_rng, PARTICLE_INIT_BOX);
+    renderer.Upload(cpu);
+
+    ParticleCompute compute("particle_step.cs");
+    compute.step = cpu.step;
+    for (int i = 0; i < STEPS; i++)
+    {
+        RandomWalkStep(cpu, particle_rng, PARTICLE_STEP, PARTICLE_BOX);
+        compute.Step(renderer, particle_rng, PARTICLE_STEP, PARTICLE_BOX);
+    }
+
+    ParticleStore gpu(COUNT);
+    renderer.Download(gpu);
+    compute.Delete();
+
+    std::size_t identical = 0;
+    for (std::size_t i = 0; i < COUNT; i++)
+        if (cpu.x[i] == gpu.x[i] && cpu.y[i] == gpu.y[i] && cpu.z[i] == gpu.z[i])
+            identical++;
+    std::cout << COUNT << " particles, " << STEPS << " steps: " << identical << " bitwise identical" << std::endl;
+
+    std::cout << "axis\t cpu mean\t gpu mean\t cpu std\t gpu std\t cpu at wall\t gpu at wall" << std::endl;
+    const char* axes = "xyz";
+    bool agree = true;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float* planes[2] = { axis == 0 ? cpu.x.data() : axis == 1 ? cpu.y.data() : cpu.z.data(),
+                                   axis == 0 ? gpu.x.data() : axis == 1 ? gpu.y.data() : gpu.z.data() };
+        double mean[2], variance[2], wall[2];
+        for (int b = 0; b < 2; b++)
+        {
+            const float* values = planes[b];
+            double sum = 0.0, squares = 0.0;
+            std::size_t atWall = 0;
+            for (std::size_t i = 0; i < COUNT; i++)
             {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
+                sum += values[i];
+                squares += (double)values[i] * values[i];
+                // the walk refuses a step past the wall, so a particle next to it is within one step
+                if (std::abs(values[i]) > PARTICLE_BOX - PARTICLE_STEP)
+                    atWall++;
             }
+            mean[b] = sum / COUNT;
+            variance[b] = squares / COUNT - mean[b] * mean[b];
+            wall[b] = (double)atWall / COUNT;
         }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        float stride = (3 + 3) * sizeof(float);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    }
-
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
-}
\ No newline at end of file
+        std::cout << axes[axis] << "\t " << mean[0] << "\t " << mean[1] << "\t " << std::sqrt(variance[0]) << "\t "
+                  << std::sqrt(variance[1]) << "\t " << wall[0] << "\t " << wall[1] << std::endl;
+
+        const double meanError = std::sqrt((variance[0] + variance[1]) / COUNT);
+        if (std::abs(mean[0] - mean[1]) > 5.0 * meanError)
+            agree = false;
+        if (std::abs(variance[0] - variance[1]) > 0.05 * variance[0])
+            agree = false;
+        if (std::abs(wall[0] - wall[1]) > 5.0 * std::sqrt((wall[0] + wall[1]) / COUNT) + 1.0 / COUNT)
+            agree = false;
+    }
+    std::cout << (agree ? "the GPU random walk agrees with the CPU one" : "the GPU random walk DIFFERS from the CPU one") << std::endl;
+    return agree;
+}
@@ -5,35 +5,34 @@
 
 out vec4 FragColor;
 
-struct Material {
+// std140 uniform blocks, mirrored on the C++ side by LightBlock and MaterialBlock (learnopengl/uniform_blocks.h):
+// the light is written once per frame for every program, the materials are static and picked by binding range
+layout (std140) uniform MaterialBlock {
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;    
     float shininess;
-}; 
+    vec3 diffuse;
+    vec3 specular;
+} material;
 
-struct Light {
-    vec3 position;  
-    vec3 direction;
+layout (std140) uniform LightBlock {
+    vec3 position;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
+
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-	
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-};
+} light;
 
 in vec3 FragPos;  
 in vec3 Normal;  
 
 uniform float alpha;
 uniform vec3 viewPos;
-uniform Material material;
-uniform Light light;
 
 void main()
 {   
@@ -0,0 +1,95 @@
+#version 330 core
+
+/*  Fragment shader of the impostor particles (see particle_impostor.vs).
+ *  Every fragment of the quad casts a ray towards the sphere of its particle: rays that miss are discarded,
+ *  the others get the position, normal and depth of the visible sphere surface and are lit like light_casters.fs.
+*/
+
+out vec4 FragColor;
+
+// same blocks as light_casters.fs
+layout (std140) uniform MaterialBlock {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+} material;
+
+layout (std140) uniform LightBlock {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+} light;
+
+in vec3 FragPos;
+flat in vec3 Center;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float particleScale;
+uniform float alpha;
+uniform vec3 viewPos;
+
+void main()
+{
+    // ray from the camera through this point of the quad, intersected with the sphere of the particle
+    vec3 rayDir = normalize(FragPos - viewPos);
+    vec3 toCenter = Center - viewPos;
+    float along = dot(rayDir, toCenter);
+    // distance of the ray from the center, measured as a vector so that no large squared lengths get subtracted
+    vec3 across = toCenter - along * rayDir;
+    float discriminant = particleScale * particleScale - dot(across, across);
+    if (discriminant < 0.0)
+        discard;
+
+    vec3 hitPos = viewPos + rayDir * (along - sqrt(discriminant));
+    vec3 Normal = (hitPos - Center) / particleScale;
+
+    // depth of the sphere surface instead of the depth of the quad, so the particles intersect correctly
+    vec4 clipPos = projection * view * vec4(hitPos, 1.0);
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clipPos.z / clipPos.w) + gl_DepthRange.near + gl_DepthRange.far);
+
+    // from here on the same lighting as light_casters.fs, evaluated at the hit point
+    // ambient
+    vec3 ambient = light.ambient * material.ambient;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - hitPos);
+    vec3 normal = normalize(Normal);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    
+    // specular
+    vec3 viewDir = normalize(viewPos - hitPos);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    vec3 specular = light.specular * (spec * material.specular); // assuming bright white light color
+    
+    // spotlight (soft edges)
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = (light.cutOff - light.outerCutOff);
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    diffuse  *= intensity;
+    specular *= intensity;
+
+    // attenuation
+    float distance = length(light.position - hitPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    
+    ambient  *= attenuation; 
+    diffuse  *= attenuation;
+    specular *= attenuation;   
+        
+    vec3 result = ambient + diffuse + specular; 
+
+    FragColor = vec4(result, alpha);
+} 
\ No newline at end of file
@@ -0,0 +1,44 @@
+#version 330 core
+
+/*  Impostor variant of particle_instanced.vs: instead of a sphere mesh every particle is drawn as one quad,
+ *  4 vertices generated from gl_VertexID, and the sphere is ray-cast per fragment in particle_impostor.fs.
+ *  The quad faces the camera and sits in front of the sphere, sized to just contain its silhouette.
+*/
+
+layout (location = 2) in float aOffsetX;
+layout (location = 3) in float aOffsetY;
+layout (location = 4) in float aOffsetZ;
+layout (location = 5) in float aPreviousX;
+layout (location = 6) in float aPreviousY;
+layout (location = 7) in float aPreviousZ;
+
+out vec3 FragPos;
+flat out vec3 Center;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+// sphere radius
+uniform float particleScale;
+// 0 draws the previous simulation step, 1 the latest one
+uniform float interpolation;
+
+void main()
+{
+    vec3 offset = mix(vec3(aPreviousX, aPreviousY, aPreviousZ), vec3(aOffsetX, aOffsetY, aOffsetZ), interpolation);
+    Center = vec3(model * vec4(offset, 1.0));
+
+    // orthonormal basis around the direction from the camera to the sphere
+    vec3 forward = normalize(Center - viewPos);
+    vec3 up = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+
+    // a plane one radius in front of the center cuts the cone of rays touching the sphere in a circle
+    // smaller than the radius, so a quad of half size particleScale covers the whole silhouette
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    FragPos = Center + (corner.x * right + corner.y * up - forward) * particleScale;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+/*  Instanced variant of light_casters.vs used for the particle system.
+ *  The sphere mesh is shared by every particle, while aOffsetX/Y/Z advance once per instance (glVertexAttribDivisor)
+ *  and hold the particle position inside the particle system, read from the x, y and z planes of the instance buffer.
+ *  aPreviousX/Y/Z hold the position of the simulation step before, the drawn position is interpolated between the two.
+*/
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in float aOffsetX;
+layout (location = 3) in float aOffsetY;
+layout (location = 4) in float aOffsetZ;
+layout (location = 5) in float aPreviousX;
+layout (location = 6) in float aPreviousY;
+layout (location = 7) in float aPreviousZ;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+uniform mat4 model;
+// inverse transpose of the upper 3x3 of model, computed on the CPU (normal_matrix.h)
+uniform mat3 normalMatrix;
+uniform mat4 view;
+uniform mat4 projection;
+uniform float particleScale;
+// 0 draws the previous simulation step, 1 the latest one
+uniform float interpolation;
+
+void main()
+{
+    // same as model * translate(offset) * scale(particleScale), without building a matrix per particle
+    vec3 offset = mix(vec3(aPreviousX, aPreviousY, aPreviousZ), vec3(aOffsetX, aOffsetY, aOffsetZ), interpolation);
+    FragPos = vec3(model * vec4(offset + aPos * particleScale, 1.0));
+    Normal = normalMatrix * aNormal;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
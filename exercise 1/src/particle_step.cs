@@ -0,0 +1,61 @@
+#version 430 core
+
+/*  One random walk step of every particle on the GPU (learnopengl/particle_compute.h), the same as RandomWalkStep
+ *  in particle_store.h: the random word of a particle comes from the same Philox4x32-10 block, and the move of each
+ *  coordinate from the same bit, so the result matches the CPU step bit for bit.
+ *  The particles are the instance buffer of ParticleRenderer: a ring of slots, each all the x, then all the y, then
+ *  all the z. The step reads the latest slot and writes the next one, which becomes the latest.
+*/
+
+layout (local_size_x = 256) in;
+
+layout (std430, binding = 0) buffer ParticleBuffer {
+    float planes[];
+};
+
+uniform uint count;
+// floats in a plane of the buffer, at least count
+uniform uint capacity;
+uniform uint readSlot;
+uniform uint writeSlot;
+
+// CounterRng key, the step as low and high word, and the random walk stream
+uniform uvec2 key;
+uniform uvec2 stepIndex;
+uniform uint stream;
+
+uniform float unit;
+uniform float wall;
+
+uvec4 philox4x32(uvec4 c, uvec2 k)
+{
+    for (int r = 0; r < 10; r++)
+    {
+        uint hi0, lo0, hi1, lo1;
+        umulExtended(0xD2511F53u, c.x, hi0, lo0);
+        umulExtended(0xCD9E8D57u, c.z, hi1, lo1);
+        c = uvec4(hi1 ^ c.y ^ k.x, lo1, hi0 ^ c.w ^ k.y, lo0);
+        k += uvec2(0x9E3779B9u, 0xBB67AE85u);
+    }
+    return c;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= count)
+        return;
+
+    // particles 4k..4k+3 share the block of counter k, as in CounterRng::Bits
+    uvec4 block = philox4x32(uvec4(i >> 2, stepIndex.x, stepIndex.y, stream), key);
+    uint bits = block[i & 3u];
+
+    for (uint j = 0u; j < 3u; j++)
+    {
+        float position = planes[(readSlot * 3u + j) * capacity + i];
+        float next = position + (((bits << j) & 0x80000000u) != 0u ? -unit : unit);
+        if (next >= -wall && next <= wall)
+            position = next;
+        planes[(writeSlot * 3u + j) * capacity + i] = position;
+    }
+}
@@ -0,0 +1,477 @@
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+#include <learnopengl/particle_store.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 30-bit Morton code of a position in [-extent, extent]: 10 bits per axis, interleaved x, y, z from bit 0 up, so
+// that the 3 top bits pick the octant of the box, the next 3 the octant of that octant, and so on.
+// ------------------------------------------------------------------------
+inline uint32_t MortonSpread(uint32_t v)
+{
+    // puts bit k of v at bit 3k
+    v = (v | (v << 16)) & 0x030000FFu;
+    v = (v | (v << 8)) & 0x0300F00Fu;
+    v = (v | (v << 4)) & 0x030C30C3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+
+inline uint32_t MortonCode(float x, float y, float z, float extent)
+{
+    const float scale = 1024.0f / (2.0f * extent);
+    int q[3] = { (int)((x + extent) * scale), (int)((y + extent) * scale), (int)((z + extent) * scale) };
+    for (int j = 0; j < 3; j++)
+        q[j] = q[j] < 0 ? 0 : (q[j] > 1023 ? 1023 : q[j]);
+    return MortonSpread((uint32_t)q[0]) | (MortonSpread((uint32_t)q[1]) << 1) | (MortonSpread((uint32_t)q[2]) << 2);
+}
+
+// Barnes-Hut octree of equal-mass particles, built as a linear octree: the particles are sorted by Morton code
+// (LSD radix sort), so that every node of the tree is a contiguous run of the sorted particles, and the nodes are
+// cut out of the sorted run top-down, the 8 children of a node stored next to each other.
+// Every node keeps the center of mass of its particles; the acceleration of a particle sums the nodes that look
+// small enough from it (opening angle theta) as single masses, and the particles of the leaves it has to open one
+// by one. A node is opened when the particle is closer than size / theta + the distance between the center of mass
+// and the center of the node, so a node holding the particle is always opened (for theta < 2 / sqrt(3)).
+// The forces are softened (Plummer): a = coupling * m * d / (|d|^2 + softening^2)^(3/2).
+// ------------------------------------------------------------------------
+class BarnesHutTree
+{
+public:
+    // particles per leaf at most, unless the leaf is at the deepest level the Morton codes resolve
+    static const uint32_t LEAF_SIZE = 16;
+    static const int MAX_DEPTH = 10;
+
+    struct Node
+    {
+        // center of mass and total mass
+        float x, y, z;
+        float mass;
+        // squared distance under which the node has to be opened
+        float open2;
+        // run of the sorted particles in the node
+        uint32_t first;
+        uint32_t count;
+        // index of the first of the children, 0 for a leaf (the root is nobody's child)
+        uint32_t child;
+        uint32_t children;
+    };
+
+    // sorts the particles and builds the nodes, over the box [-extent, extent]
+    void Build(const ParticleStore& particles, ThreadPool& pool, float particleMass, float extent, float theta)
+    {
+        const std::size_t n = particles.Size();
+        mass = particleMass;
+        keys.resize(n);
+        pool.ParallelFor(n, 4096, [this, &particles, extent](std::size_t first, std::size_t last)
+        {
+            for (std::size_t i = first; i < last; i++)
+                keys[i] = ((uint64_t)MortonCode(particles.x[i], particles.y[i], particles.z[i], extent) << 32) | (uint64_t)i;
+        });
+        SortKeys();
+
+        order.resize(n);
+        sx.resize(n);
+        sy.resize(n);
+        sz.resize(n);
+        pool.ParallelFor(n, 4096, [this, &particles](std::size_t first, std::size_t last)
+        {
+            for (std::size_t k = first; k < last; k++)
+            {
+                uint32_t i = (uint32_t)keys[k];
+                order[k] = i;
+                sx[k] = particles.x[i];
+                sy[k] = particles.y[i];
+                sz[k] = particles.z[i];
+            }
+        });
+
+        nodes.clear();
+        if (n == 0)
+            return;
+        nodes.push_back(Node());
+        BuildNode(0, 0, (uint32_t)n, 0, -extent, -extent, -extent, 2.0f * extent, theta);
+    }
+
+    // acceleration of every particle, written at its index in the ParticleStore the tree was built from
+    void Accelerations(ThreadPool& pool, float coupling, float softening, float* ax, float* ay, float* az) const
+    {
+        const float soft2 = softening * softening;
+        pool.ParallelFor(order.size(), 256, [this, coupling, soft2, ax, ay, az](std::size_t first, std::size_t last)
+        {
+            for (std::size_t k = first; k < last; k++)
+            {
+                float a[3];
+                Acceleration((uint32_t)k, soft2, a);
+                const uint32_t i = order[k];
+                ax[i] = coupling * a[0];
+                ay[i] = coupling * a[1];
+                az[i] = coupling * a[2];
+            }
+        });
+    }
+
+    std::size_t NodeCount() const { return nodes.size(); }
+
+private:
+    float mass;
+    std::vector<Node> nodes;
+    // Morton code in the high word, particle index in the low word; sorted
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> sortedKeys;
+    // particle index and position of the sorted particles
+    std::vector<uint32_t> order;
+    std::vector<float> sx, sy, sz;
+
+    // same radix sort as RenderQueue, on the code bits only: the indices are already in order
+    void SortKeys()
+    {
+        const std::size_t n = keys.size();
+        sortedKeys.resize(n);
+        if (n < 2)
+            return;
+
+        for (unsigned int shift = 32; shift < 64; shift += 8)
+        {
+            std::size_t offsets[256] = { 0 };
+            for (std::size_t i = 0; i < n; i++)
+                offsets[(keys[i] >> shift) & 0xFF]++;
+            if (offsets[(keys[0] >> shift) & 0xFF] == n)
+                continue;
+
+            std::size_t sum = 0;
+            for (unsigned int d = 0; d < 256; d++)
+            {
+                std::size_t digits = offsets[d];
+                offsets[d] = sum;
+                sum += digits;
+            }
+            for (std::size_t i = 0; i < n; i++)
+                sortedKeys[offsets[(keys[i] >> shift) & 0xFF]++] = keys[i];
+            keys.swap(sortedKeys);
+        }
+    }
+
+    // fills nodes[index] with the sorted particles [first, last), in the cube of corner (cx, cy, cz) and edge size
+    void BuildNode(uint32_t index, uint32_t first, uint32_t last, int depth, float cx, float cy, float cz, float size, float theta)
+    {
+        double x = 0.0, y = 0.0, z = 0.0;
+        uint32_t child = 0, children = 0;
+
+        if (last - first <= LEAF_SIZE || depth == MAX_DEPTH)
+        {
+            for (uint32_t k = first; k < last; k++)
+            {
+                x += sx[k];
+                y += sy[k];
+                z += sz[k];
+            }
+        }
+        else
+        {
+            // the octant of every particle at this depth is the next 3 bits of its code; the particles are sorted,
+            // so each octant is one run
+            const unsigned int shift = 32 + 3 * (MAX_DEPTH - 1 - depth);
+            uint32_t bounds[9];
+            bounds[0] = first;
+            uint32_t k = first;
+            for (unsigned int octant = 0; octant < 8; octant++)
+            {
+                while (k < last && ((keys[k] >> shift) & 7) == octant)
+                    k++;
+                bounds[octant + 1] = k;
+                if (bounds[octant + 1] > bounds[octant])
+                    children++;
+            }
+
+            // the children are allocated together before any of them is built
+            child = (uint32_t)nodes.size();
+            nodes.resize(nodes.size() + children);
+            const float half = 0.5f * size;
+            uint32_t next = child;
+            for (unsigned int octant = 0; octant < 8; octant++)
+            {
+                if (bounds[octant + 1] == bounds[octant])
+                    continue;
+                BuildNode(next, bounds[octant], bounds[octant + 1], depth + 1,
+                          cx + ((octant & 1) ? half : 0.0f), cy + ((octant & 2) ? half : 0.0f), cz + ((octant & 4) ? half : 0.0f),
+                          half, theta);
+                const Node& built = nodes[next];
+                x += (double)built.x * built.count;
+                y += (double)built.y * built.count;
+                z += (double)built.z * built.count;
+                next++;
+            }
+        }
+
+        Node& node = nodes[index];
+        const uint32_t count = last - first;
+        node.x = (float)(x / count);
+        node.y = (float)(y / count);
+        node.z = (float)(z / count);
+        node.mass = mass * count;
+        node.first = first;
+        node.count = count;
+        node.child = child;
+        node.children = children;
+
+        const float dx = node.x - (cx + 0.5f * size), dy = node.y - (cy + 0.5f * size), dz = node.z - (cz + 0.5f * size);
+        const float open = size / theta + std::sqrt(dx * dx + dy * dy + dz * dz);
+        node.open2 = open * open;
+    }
+
+    // acceleration of the sorted particle k, without the coupling
+    void Acceleration(uint32_t k, float soft2, float a[3]) const
+    {
+        const float px = sx[k], py = sy[k], pz = sz[k];
+        float ax = 0.0f, ay = 0.0f, az = 0.0f;
+
+        uint32_t stack[8 * (MAX_DEPTH + 1)];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = nodes[stack[--top]];
+            const float dx = node.x - px, dy = node.y - py, dz = node.z - pz;
+            const float d2 = dx * dx + dy * dy + dz * dz;
+
+            if (d2 > node.open2)
+            {
+                const float r2 = d2 + soft2;
+                const float s = node.mass / (r2 * std::sqrt(r2));
+                ax += s * dx;
+                ay += s * dy;
+                az += s * dz;
+            }
+            else if (node.child == 0)
+            {
+                for (uint32_t j = node.first; j < node.first + node.count; j++)
+                {
+                    if (j == k)
+                        continue;
+                    const float ex = sx[j] - px, ey = sy[j] - py, ez = sz[j] - pz;
+                    const float r2 = ex * ex + ey * ey + ez * ez + soft2;
+                    const float s = mass / (r2 * std::sqrt(r2));
+                    ax += s * ex;
+                    ay += s * ey;
+                    az += s * ez;
+                }
+            }
+            else
+            {
+                for (uint32_t c = 0; c < node.children; c++)
+                    stack[top++] = node.child + c;
+            }
+        }
+        a[0] = ax;
+        a[1] = ay;
+        a[2] = az;
+    }
+};
+
+// N-body motion of the particles of a ParticleStore: equal masses, softened pairwise forces, integrated with a
+// kick-drift-kick leapfrog and reflected off the walls of the box. The forces come from a BarnesHutTree rebuilt
+// every step, or from the direct O(N^2) sum (for reference). A positive coupling attracts (gravity), a negative one
+// repels (charges of the same sign).
+// The velocities are kept here; Reset must follow any change of the positions made elsewhere.
+// ------------------------------------------------------------------------
+class NBodySystem
+{
+public:
+    // G * (total mass), or its negative for repulsion
+    float coupling;
+    float softening;
+    float theta;
+    float timeStep;
+    // sums the forces directly instead of through the tree
+    bool direct;
+
+    // of the last Step: building the tree, computing the forces, and the two kicks and the drift
+    double buildSeconds;
+    double forceSeconds;
+    double integrateSeconds;
+
+    NBodySystem(float couplingConstant = 1.0f, float softeningLength = 0.01f, float openingAngle = 0.5f, float dt = 0.001f)
+        : coupling(couplingConstant), softening(softeningLength), theta(openingAngle), timeStep(dt), direct(false),
+          buildSeconds(0.0), forceSeconds(0.0), integrateSeconds(0.0), accelerationsValid(false)
+    {
+    }
+
+    // the particles start at rest at their current positions
+    void Reset(const ParticleStore& particles)
+    {
+        const std::size_t n = particles.Size();
+        vx.assign(n, 0.0f);
+        vy.assign(n, 0.0f);
+        vz.assign(n, 0.0f);
+        ax.assign(n, 0.0f);
+        ay.assign(n, 0.0f);
+        az.assign(n, 0.0f);
+        accelerationsValid = false;
+    }
+
+    // one leapfrog step of timeStep, in the box [-wall, wall]
+    void Step(ParticleStore& particles, ThreadPool& pool, float wall)
+    {
+        if (vx.size() != particles.Size())
+            Reset(particles);
+        buildSeconds = forceSeconds = integrateSeconds = 0.0;
+        if (!accelerationsValid)
+            ComputeAccelerations(particles, pool, wall);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const float dt = timeStep;
+        pool.ParallelFor(particles.Size(), 4096, [this, &particles, dt, wall](std::size_t first, std::size_t last)
+        {
+            float* coords[3] = { particles.x.data(), particles.y.data(), particles.z.data() };
+            float* velocities[3] = { vx.data(), vy.data(), vz.data() };
+            const float* accelerations[3] = { ax.data(), ay.data(), az.data() };
+            for (int j = 0; j < 3; j++)
+            {
+                for (std::size_t i = first; i < last; i++)
+                {
+                    float v = velocities[j][i] + 0.5f * dt * accelerations[j][i];
+                    float p = coords[j][i] + dt * v;
+                    // elastic bounce off the walls
+                    if (p > wall)
+                    {
+                        p = 2.0f * wall - p;
+                        v = -v;
+                    }
+                    else if (p < -wall)
+                    {
+                        p = -2.0f * wall - p;
+                        v = -v;
+                    }
+                    velocities[j][i] = v;
+                    coords[j][i] = p;
+                }
+            }
+        });
+        integrateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        ComputeAccelerations(particles, pool, wall);
+
+        start = std::chrono::steady_clock::now();
+        pool.ParallelFor(particles.Size(), 4096, [this, dt](std::size_t first, std::size_t last)
+        {
+            for (std::size_t i = first; i < last; i++)
+            {
+                vx[i] += 0.5f * dt * ax[i];
+                vy[i] += 0.5f * dt * ay[i];
+                vz[i] += 0.5f * dt * az[i];
+            }
+        });
+        integrateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        particles.step++;
+    }
+
+    // accelerations of the last Step (or ComputeAccelerations), by particle index
+    const float* AccelerationX() const { return ax.data(); }
+    const float* AccelerationY() const { return ay.data(); }
+    const float* AccelerationZ() const { return az.data(); }
+
+    void ComputeAccelerations(const ParticleStore& particles, ThreadPool& pool, float wall)
+    {
+        const std::size_t n = particles.Size();
+        if (ax.size() != n)
+        {
+            ax.assign(n, 0.0f);
+            ay.assign(n, 0.0f);
+            az.assign(n, 0.0f);
+        }
+        const float particleMass = n > 0 ? 1.0f / n : 0.0f;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (direct)
+            DirectAccelerations(particles, pool, ax.data(), ay.data(), az.data());
+        else
+        {
+            tree.Build(particles, pool, particleMass, wall, theta);
+            std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now();
+            buildSeconds += std::chrono::duration<double>(built - start).count();
+            start = built;
+            tree.Accelerations(pool, coupling, softening, ax.data(), ay.data(), az.data());
+        }
+        forceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        accelerationsValid = true;
+    }
+
+    // the O(N^2) reference: every pair summed directly
+    void DirectAccelerations(const ParticleStore& particles, ThreadPool& pool, float* outX, float* outY, float* outZ) const
+    {
+        const std::size_t n = particles.Size();
+        const float particleMass = n > 0 ? 1.0f / n : 0.0f;
+        const float soft2 = softening * softening;
+        const float scale = coupling * particleMass;
+        pool.ParallelFor(n, 64, [&particles, n, soft2, scale, outX, outY, outZ](std::size_t first, std::size_t last)
+        {
+            const float* x = particles.x.data();
+            const float* y = particles.y.data();
+            const float* z = particles.z.data();
+            for (std::size_t i = first; i < last; i++)
+            {
+                float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f;
+                for (std::size_t j = 0; j < n; j++)
+                {
+                    const float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                    const float r2 = dx * dx + dy * dy + dz * dz + soft2;
+                    // the particle itself adds 0
+                    const float s = 1.0f / (r2 * std::sqrt(r2));
+                    sumX += s * dx;
+                    sumY += s * dy;
+                    sumZ += s * dz;
+                }
+                outX[i] = scale * sumX;
+                outY[i] = scale * sumY;
+                outZ[i] = scale * sumZ;
+            }
+        });
+    }
+
+    // kinetic plus potential energy, the potential summed over every pair (O(N^2)) in double precision
+    double Energy(const ParticleStore& particles, ThreadPool& pool) const
+    {
+        const std::size_t n = particles.Size();
+        if (n == 0)
+            return 0.0;
+        const double particleMass = 1.0 / n;
+        const double soft2 = (double)softening * softening;
+        // per-particle sums, added up in order so that the result does not depend on the threads
+        std::vector<double> energies(n, 0.0);
+        pool.ParallelFor(n, 64, [this, &particles, &energies, n, particleMass, soft2](std::size_t first, std::size_t last)
+        {
+            for (std::size_t i = first; i < last; i++)
+            {
+                double potential = 0.0;
+                for (std::size_t j = i + 1; j < n; j++)
+                {
+                    const double dx = particles.x[j] - particles.x[i], dy = particles.y[j] - particles.y[i], dz = particles.z[j] - particles.z[i];
+                    potential += 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz + soft2);
+                }
+                double v2 = i < vx.size() ? (double)vx[i] * vx[i] + (double)vy[i] * vy[i] + (double)vz[i] * vz[i] : 0.0;
+                energies[i] = 0.5 * particleMass * v2 - coupling * particleMass * particleMass * potential;
+            }
+        });
+        double energy = 0.0;
+        for (std::size_t i = 0; i < n; i++)
+            energy += energies[i];
+        return energy;
+    }
+
+    std::size_t TreeNodes() const { return tree.NodeCount(); }
+
+private:
+    BarnesHutTree tree;
+    std::vector<float, AlignedAllocator<float> > vx, vy, vz;
+    std::vector<float, AlignedAllocator<float> > ax, ay, az;
+    // false until the accelerations of the current positions are known (the first kick needs them)
+    bool accelerationsValid;
+};
+#endif
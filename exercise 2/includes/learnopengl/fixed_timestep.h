@@ -0,0 +1,67 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Accumulator-based fixed timestep driver.
+// Real elapsed time is added to an accumulator and consumed in whole simulation steps, so the simulation
+// advances at the same rate whatever the frame rate is: a fast frame may run no step at all, a slow one several.
+// To avoid the spiral of death (steps taking longer than the time they simulate) the number of steps per call
+// is capped and the time that could not be simulated is dropped.
+class FixedTimestep
+{
+public:
+    FixedTimestep(double stepSeconds, unsigned int maxStepsPerCall = 8)
+        : step(stepSeconds), maxSteps(maxStepsPerCall), accumulator(0.0), dropped(0.0)
+    {
+    }
+
+    // adds the elapsed time and returns how many steps should be simulated now
+    unsigned int Advance(double elapsed)
+    {
+        accumulator += elapsed;
+
+        unsigned int steps = (unsigned int)(accumulator / step);
+        if (steps > maxSteps)
+        {
+            dropped += (steps - maxSteps) * step;
+            steps = maxSteps;
+        }
+        accumulator -= steps * step;
+        if (accumulator >= step)
+        {
+            // whatever is left beyond one step was dropped by the cap above
+            accumulator -= (unsigned int)(accumulator / step) * step;
+        }
+        return steps;
+    }
+
+    // how far the current time is between the last simulated state (0) and the next one (1),
+    // used to interpolate the rendered state
+    float Alpha() const
+    {
+        return (float)(accumulator / step);
+    }
+
+    // time left before the next step is due
+    double Remaining() const
+    {
+        return step - accumulator;
+    }
+
+    double Step() const
+    {
+        return step;
+    }
+
+    // total simulation time skipped because of the catch-up limit
+    double Dropped() const
+    {
+        return dropped;
+    }
+
+private:
+    double step;
+    unsigned int maxSteps;
+    double accumulator;
+    double dropped;
+};
+#endif
@@ -0,0 +1,52 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six planes (ax + by + cz + d >= 0 inside) extracted from a projection * view matrix,
+// for culling objects by their bounding boxes before they are submitted.
+class Frustum
+{
+public:
+    enum Plane { LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE, PLANES };
+
+    glm::vec4 planes[PLANES];
+
+    Frustum()
+    {
+        for (int i = 0; i < PLANES; i++)
+            planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        // clip space is -w <= x, y, z <= w: each plane is the last row of the matrix plus or minus another row
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        planes[LEFT_PLANE] = row[3] + row[0];
+        planes[RIGHT_PLANE] = row[3] - row[0];
+        planes[BOTTOM_PLANE] = row[3] + row[1];
+        planes[TOP_PLANE] = row[3] - row[1];
+        planes[NEAR_PLANE] = row[3] + row[2];
+        planes[FAR_PLANE] = row[3] - row[2];
+    }
+
+    // false only if the box is entirely outside one of the planes; boxes near a corner of the frustum
+    // may be reported as intersecting when they are not, which only costs a draw
+    bool Intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+    {
+        for (int i = 0; i < PLANES; i++)
+        {
+            // the corner of the box farthest along the plane normal
+            glm::vec3 corner(planes[i].x >= 0.0f ? boxMax.x : boxMin.x,
+                             planes[i].y >= 0.0f ? boxMax.y : boxMin.y,
+                             planes[i].z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+#endif
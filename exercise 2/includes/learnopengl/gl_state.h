@@ -0,0 +1,326 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/render_state.h>
+
+// Binding and state calls of the whole program, counted since the last reset (e.g. once per frame).
+struct GLStateCounters
+{
+    // calls that reached the driver
+    unsigned long long issued;
+    // calls dropped because the object was already bound, or the state already set
+    unsigned long long elided;
+
+    GLStateCounters() : issued(0), elided(0)
+    {
+    }
+};
+
+inline GLStateCounters& GlobalGLStateCounters()
+{
+    static GLStateCounters counters;
+    return counters;
+}
+
+// Shadow of the object bindings of the GL context: the current program, vertex array, the buffer bound to each
+// target and to each uniform block binding point, the active texture unit and the textures bound to each unit;
+// and of the fixed-function RenderState of the last draw.
+// Binding an object that is already bound, or setting a state to its current value, is a driver call that
+// changes nothing, so it is dropped.
+// The shadow only knows about the calls made through it: every bind of the program must go through this class,
+// and code that binds objects behind its back has to call Invalidate() afterwards.
+// ------------------------------------------------------------------------
+class GLState
+{
+public:
+    static const unsigned int BUFFER_TARGETS = 9;
+    static const unsigned int UNIFORM_BINDINGS = 16;
+    static const unsigned int TEXTURE_UNITS = 16;
+    static const unsigned int TEXTURE_TARGETS = 2;
+
+    GLState()
+    {
+        Invalidate();
+    }
+
+    // forgets everything, the next call of every kind reaches the driver
+    void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        for (unsigned int i = 0; i < BUFFER_TARGETS; i++)
+            buffers[i] = UNKNOWN;
+        for (unsigned int i = 0; i < UNIFORM_BINDINGS; i++)
+            uniformRanges[i].buffer = UNKNOWN;
+        activeTexture = UNKNOWN;
+        for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (unsigned int i = 0; i < TEXTURE_TARGETS; i++)
+                textures[unit][i] = UNKNOWN;
+        renderStateKnown = false;
+    }
+
+    // makes state the one of the next draws, with a GL call for each field that differs from the current state
+    void Apply(const RenderState& state)
+    {
+        const RenderState& current = renderState;
+        const bool all = !renderStateKnown;
+
+        if (Differs(all || state.depthTest != current.depthTest))
+            SetCapability(GL_DEPTH_TEST, state.depthTest);
+        if (Differs(all || state.depthWrite != current.depthWrite))
+            glDepthMask(state.depthWrite ? GL_TRUE : GL_FALSE);
+        if (Differs(all || state.depthFunc != current.depthFunc))
+            glDepthFunc(state.depthFunc);
+
+        if (Differs(all || state.blend != current.blend))
+            SetCapability(GL_BLEND, state.blend);
+        // the blend function and the culled faces only matter while enabled: a disabled one keeps the function
+        // set last, so that turning it back on with the same function costs a single call
+        RenderState applied = state;
+        if (state.blend)
+        {
+            if (Differs(all || state.blendSource != current.blendSource || state.blendDestination != current.blendDestination))
+                glBlendFunc(state.blendSource, state.blendDestination);
+        }
+        else if (!all)
+        {
+            applied.blendSource = current.blendSource;
+            applied.blendDestination = current.blendDestination;
+        }
+        else
+        {
+            Differs(true);
+            glBlendFunc(state.blendSource, state.blendDestination);
+        }
+
+        if (Differs(all || state.polygonMode != current.polygonMode))
+            glPolygonMode(GL_FRONT_AND_BACK, state.polygonMode);
+
+        if (Differs(all || state.cullFace != current.cullFace))
+            SetCapability(GL_CULL_FACE, state.cullFace);
+        if (state.cullFace || all)
+        {
+            if (Differs(all || state.cullMode != current.cullMode))
+                glCullFace(state.cullMode);
+        }
+        else
+            applied.cullMode = current.cullMode;
+
+        renderState = applied;
+        renderStateKnown = true;
+    }
+
+    void UseProgram(GLuint id)
+    {
+        if (Changed(program, id))
+            glUseProgram(id);
+    }
+
+    void BindVertexArray(GLuint id)
+    {
+        if (!Changed(vertexArray, id))
+            return;
+        glBindVertexArray(id);
+        // the element array buffer binding is part of the vertex array object
+        buffers[BufferTarget(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+
+    void BindBuffer(GLenum target, GLuint id)
+    {
+        int index = BufferTarget(target);
+        if (index < 0)
+        {
+            GlobalGLStateCounters().issued++;
+            glBindBuffer(target, id);
+        }
+        else if (Changed(buffers[index], id))
+            glBindBuffer(target, id);
+    }
+
+    // glBindBufferRange on the uniform block binding points, which also binds the buffer to GL_UNIFORM_BUFFER
+    void BindUniformRange(GLuint binding, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        GLStateCounters& counters = GlobalGLStateCounters();
+        if (binding < UNIFORM_BINDINGS)
+        {
+            UniformRange& range = uniformRanges[binding];
+            if (range.buffer == id && range.offset == offset && range.size == size)
+            {
+                counters.elided++;
+                return;
+            }
+            range.buffer = id;
+            range.offset = offset;
+            range.size = size;
+        }
+        counters.issued++;
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, id, offset, size);
+        buffers[BufferTarget(GL_UNIFORM_BUFFER)] = id;
+    }
+
+    // glBindBufferBase on a shader storage binding point, which also binds the buffer to GL_SHADER_STORAGE_BUFFER;
+    // the binding points themselves are not shadowed, storage buffers are only bound around compute dispatches
+    void BindStorageBase(GLuint binding, GLuint id)
+    {
+        GlobalGLStateCounters().issued++;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, id);
+        buffers[BufferTarget(GL_SHADER_STORAGE_BUFFER)] = id;
+    }
+
+    void ActiveTexture(GLenum unit)
+    {
+        if (Changed(activeTexture, unit))
+            glActiveTexture(unit);
+    }
+
+    // binds the texture to the active unit
+    void BindTexture(GLenum target, GLuint id)
+    {
+        int index = TextureTarget(target);
+        unsigned int unit = activeTexture - GL_TEXTURE0;
+        if (index < 0 || unit >= TEXTURE_UNITS)
+        {
+            GlobalGLStateCounters().issued++;
+            glBindTexture(target, id);
+        }
+        else if (Changed(textures[unit][index], id))
+            glBindTexture(target, id);
+    }
+
+    // deleting an object unbinds it, and its name can be handed out again by glGen*: the shadow must not keep it
+    void DeleteProgram(GLuint id)
+    {
+        glDeleteProgram(id);
+        if (program == id)
+            program = UNKNOWN;
+    }
+
+    void DeleteVertexArrays(GLsizei count, const GLuint* ids)
+    {
+        glDeleteVertexArrays(count, ids);
+        for (GLsizei i = 0; i < count; i++)
+        {
+            if (vertexArray == ids[i])
+            {
+                vertexArray = UNKNOWN;
+                buffers[BufferTarget(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+            }
+        }
+    }
+
+    void DeleteBuffers(GLsizei count, const GLuint* ids)
+    {
+        glDeleteBuffers(count, ids);
+        for (GLsizei i = 0; i < count; i++)
+        {
+            for (unsigned int t = 0; t < BUFFER_TARGETS; t++)
+                if (buffers[t] == ids[i])
+                    buffers[t] = UNKNOWN;
+            for (unsigned int b = 0; b < UNIFORM_BINDINGS; b++)
+                if (uniformRanges[b].buffer == ids[i])
+                    uniformRanges[b].buffer = UNKNOWN;
+        }
+    }
+
+    void DeleteTextures(GLsizei count, const GLuint* ids)
+    {
+        glDeleteTextures(count, ids);
+        for (GLsizei i = 0; i < count; i++)
+            for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+                for (unsigned int t = 0; t < TEXTURE_TARGETS; t++)
+                    if (textures[unit][t] == ids[i])
+                        textures[unit][t] = UNKNOWN;
+    }
+
+private:
+    // never a valid name, nor a valid texture unit
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    struct UniformRange
+    {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint buffers[BUFFER_TARGETS];
+    UniformRange uniformRanges[UNIFORM_BINDINGS];
+    GLenum activeTexture;
+    GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+    RenderState renderState;
+    // false until the first Apply, which then sets every field
+    bool renderStateKnown;
+
+    // true if the shadow differs from value, which it then takes; counts the call either way
+    static bool Changed(GLuint& shadow, GLuint value)
+    {
+        GLStateCounters& counters = GlobalGLStateCounters();
+        if (shadow == value)
+        {
+            counters.elided++;
+            return false;
+        }
+        shadow = value;
+        counters.issued++;
+        return true;
+    }
+
+    // counts a state call as issued if differs, as elided otherwise
+    static bool Differs(bool differs)
+    {
+        GLStateCounters& counters = GlobalGLStateCounters();
+        if (differs)
+            counters.issued++;
+        else
+            counters.elided++;
+        return differs;
+    }
+
+    static void SetCapability(GLenum capability, bool enabled)
+    {
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    // slot of the buffer targets that are shadowed, -1 for the others
+    static int BufferTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_COPY_READ_BUFFER: return 3;
+        case GL_COPY_WRITE_BUFFER: return 4;
+        case GL_PIXEL_PACK_BUFFER: return 5;
+        case GL_PIXEL_UNPACK_BUFFER: return 6;
+        case GL_DRAW_INDIRECT_BUFFER: return 7;
+        case GL_SHADER_STORAGE_BUFFER: return 8;
+        default: return -1;
+        }
+    }
+
+    static int TextureTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        default: return -1;
+        }
+    }
+};
+
+// the bindings of the one GL context of the program
+inline GLState& GlobalGLState()
+{
+    static GLState state;
+    return state;
+}
+#endif
@@ -0,0 +1,196 @@
+#ifndef NORMAL_MATRIX_H
+#define NORMAL_MATRIX_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#define NORMAL_MATRIX_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define NORMAL_MATRIX_SSE
+#endif
+
+// Normal matrices, i.e. the inverse transpose of the upper 3x3 of a model matrix, computed on the CPU once per object
+// instead of once per vertex in the shader. With a, b and c the first three columns of the model matrix, the inverse
+// transpose has columns cross(b, c), cross(c, a) and cross(a, b), all divided by det = dot(a, cross(b, c)):
+// 9 products for each column and a single division, no general 4x4 inverse.
+// ------------------------------------------------------------------------
+inline glm::mat3 NormalMatrix(const glm::mat4& model)
+{
+    glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+    glm::vec3 bc = glm::cross(b, c);
+    float inverseDet = 1.0f / glm::dot(a, bc);
+    return glm::mat3(bc * inverseDet, glm::cross(c, a) * inverseDet, glm::cross(a, b) * inverseDet);
+}
+
+inline void NormalMatricesScalar(const glm::mat4* models, glm::mat3* normals, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+        normals[i] = NormalMatrix(models[i]);
+}
+
+#if defined(NORMAL_MATRIX_AVX) || defined(NORMAL_MATRIX_SSE)
+// stores the 3 columns (x, y, z and a spare lane) of a mat3: each column is 12 bytes, so the 16-byte store of
+// a column spills one float into the next column, or into the next matrix, which is written afterwards
+inline void NormalMatrixStoreColumns(float* out, __m128 c0, __m128 c1, __m128 c2)
+{
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 3, c1);
+    _mm_storeu_ps(out + 6, c2);
+}
+
+// same for the last matrix of a batch, whose third column must not run past the end
+inline void NormalMatrixStoreLastColumns(float* out, __m128 c0, __m128 c1, __m128 c2)
+{
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 3, c1);
+    _mm_storel_pi((__m64*)(out + 6), c2);
+    _mm_store_ss(out + 8, _mm_movehl_ps(c2, c2));
+}
+#endif
+
+#if defined(NORMAL_MATRIX_AVX)
+// x, y and z of column k of 8 consecutive matrices, one matrix per lane; the two 128-bit halves hold matrices
+// 0-3 and 4-7, so a single 256-bit transpose serves 8 matrices
+inline void NormalMatrixLoadColumn(const glm::mat4* models, int k, __m256& x, __m256& y, __m256& z)
+{
+    __m256 c0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&models[0][k][0])), _mm_loadu_ps(&models[4][k][0]), 1);
+    __m256 c1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&models[1][k][0])), _mm_loadu_ps(&models[5][k][0]), 1);
+    __m256 c2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&models[2][k][0])), _mm_loadu_ps(&models[6][k][0]), 1);
+    __m256 c3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&models[3][k][0])), _mm_loadu_ps(&models[7][k][0]), 1);
+    __m256 t0 = _mm256_unpacklo_ps(c0, c1);
+    __m256 t1 = _mm256_unpacklo_ps(c2, c3);
+    __m256 t2 = _mm256_unpackhi_ps(c0, c1);
+    __m256 t3 = _mm256_unpackhi_ps(c2, c3);
+    x = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    y = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    z = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+}
+
+// the inverse of NormalMatrixLoadColumn: column of matrix j (low half) and j + 4 (high half) in cj
+inline void NormalMatrixPackColumn(__m256 x, __m256 y, __m256 z, __m256& c0, __m256& c1, __m256& c2, __m256& c3)
+{
+    __m256 t0 = _mm256_unpacklo_ps(x, y);
+    __m256 t1 = _mm256_unpackhi_ps(x, y);
+    __m256 t2 = _mm256_unpacklo_ps(z, z);
+    __m256 t3 = _mm256_unpackhi_ps(z, z);
+    c0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    c1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    c2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    c3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+#elif defined(NORMAL_MATRIX_SSE)
+// x, y and z of column k of 4 consecutive matrices, one matrix per lane
+inline void NormalMatrixLoadColumn(const glm::mat4* models, int k, __m128& x, __m128& y, __m128& z)
+{
+    __m128 c0 = _mm_loadu_ps(&models[0][k][0]);
+    __m128 c1 = _mm_loadu_ps(&models[1][k][0]);
+    __m128 c2 = _mm_loadu_ps(&models[2][k][0]);
+    __m128 c3 = _mm_loadu_ps(&models[3][k][0]);
+    __m128 t0 = _mm_unpacklo_ps(c0, c1);
+    __m128 t1 = _mm_unpacklo_ps(c2, c3);
+    __m128 t2 = _mm_unpackhi_ps(c0, c1);
+    __m128 t3 = _mm_unpackhi_ps(c2, c3);
+    x = _mm_movelh_ps(t0, t1);
+    y = _mm_movehl_ps(t1, t0);
+    z = _mm_movelh_ps(t2, t3);
+}
+
+// the inverse of NormalMatrixLoadColumn: column of matrix j in cj
+inline void NormalMatrixPackColumn(__m128 x, __m128 y, __m128 z, __m128& c0, __m128& c1, __m128& c2, __m128& c3)
+{
+    __m128 t0 = _mm_unpacklo_ps(x, y);
+    __m128 t1 = _mm_unpackhi_ps(x, y);
+    __m128 t2 = _mm_unpacklo_ps(z, z);
+    __m128 t3 = _mm_unpackhi_ps(z, z);
+    c0 = _mm_movelh_ps(t0, t2);
+    c1 = _mm_movehl_ps(t2, t0);
+    c2 = _mm_movelh_ps(t1, t3);
+    c3 = _mm_movehl_ps(t3, t1);
+}
+#endif
+
+// batched version: the matrices are transposed so that each vector lane holds a different matrix, 8 (AVX) or
+// 4 (SSE) at a time, and the cross products become plain multiplies and subtractions without any shuffle.
+// The kernels are written out without loops over vector arrays so that they stay in registers at any optimization level.
+inline void NormalMatrices(const glm::mat4* models, glm::mat3* normals, std::size_t count)
+{
+    std::size_t i = 0;
+
+#if defined(NORMAL_MATRIX_AVX)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 ax, ay, az, bx, by, bz, cx, cy, cz;
+        NormalMatrixLoadColumn(models + i, 0, ax, ay, az);
+        NormalMatrixLoadColumn(models + i, 1, bx, by, bz);
+        NormalMatrixLoadColumn(models + i, 2, cx, cy, cz);
+
+        // cross(b, c), cross(c, a) and cross(a, b)
+        __m256 r0x = _mm256_sub_ps(_mm256_mul_ps(by, cz), _mm256_mul_ps(bz, cy));
+        __m256 r0y = _mm256_sub_ps(_mm256_mul_ps(bz, cx), _mm256_mul_ps(bx, cz));
+        __m256 r0z = _mm256_sub_ps(_mm256_mul_ps(bx, cy), _mm256_mul_ps(by, cx));
+        __m256 r1x = _mm256_sub_ps(_mm256_mul_ps(cy, az), _mm256_mul_ps(cz, ay));
+        __m256 r1y = _mm256_sub_ps(_mm256_mul_ps(cz, ax), _mm256_mul_ps(cx, az));
+        __m256 r1z = _mm256_sub_ps(_mm256_mul_ps(cx, ay), _mm256_mul_ps(cy, ax));
+        __m256 r2x = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+        __m256 r2y = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+        __m256 r2z = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, r0x), _mm256_mul_ps(ay, r0y)), _mm256_mul_ps(az, r0z));
+        __m256 inverseDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+        __m256 p00, p01, p02, p03, p10, p11, p12, p13, p20, p21, p22, p23;
+        NormalMatrixPackColumn(_mm256_mul_ps(r0x, inverseDet), _mm256_mul_ps(r0y, inverseDet), _mm256_mul_ps(r0z, inverseDet), p00, p01, p02, p03);
+        NormalMatrixPackColumn(_mm256_mul_ps(r1x, inverseDet), _mm256_mul_ps(r1y, inverseDet), _mm256_mul_ps(r1z, inverseDet), p10, p11, p12, p13);
+        NormalMatrixPackColumn(_mm256_mul_ps(r2x, inverseDet), _mm256_mul_ps(r2y, inverseDet), _mm256_mul_ps(r2z, inverseDet), p20, p21, p22, p23);
+
+        float* out = &normals[i][0][0];
+        NormalMatrixStoreColumns(out, _mm256_castps256_ps128(p00), _mm256_castps256_ps128(p10), _mm256_castps256_ps128(p20));
+        NormalMatrixStoreColumns(out + 9, _mm256_castps256_ps128(p01), _mm256_castps256_ps128(p11), _mm256_castps256_ps128(p21));
+        NormalMatrixStoreColumns(out + 18, _mm256_castps256_ps128(p02), _mm256_castps256_ps128(p12), _mm256_castps256_ps128(p22));
+        NormalMatrixStoreColumns(out + 27, _mm256_castps256_ps128(p03), _mm256_castps256_ps128(p13), _mm256_castps256_ps128(p23));
+        NormalMatrixStoreColumns(out + 36, _mm256_extractf128_ps(p00, 1), _mm256_extractf128_ps(p10, 1), _mm256_extractf128_ps(p20, 1));
+        NormalMatrixStoreColumns(out + 45, _mm256_extractf128_ps(p01, 1), _mm256_extractf128_ps(p11, 1), _mm256_extractf128_ps(p21, 1));
+        NormalMatrixStoreColumns(out + 54, _mm256_extractf128_ps(p02, 1), _mm256_extractf128_ps(p12, 1), _mm256_extractf128_ps(p22, 1));
+        NormalMatrixStoreLastColumns(out + 63, _mm256_extractf128_ps(p03, 1), _mm256_extractf128_ps(p13, 1), _mm256_extractf128_ps(p23, 1));
+    }
+#elif defined(NORMAL_MATRIX_SSE)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 ax, ay, az, bx, by, bz, cx, cy, cz;
+        NormalMatrixLoadColumn(models + i, 0, ax, ay, az);
+        NormalMatrixLoadColumn(models + i, 1, bx, by, bz);
+        NormalMatrixLoadColumn(models + i, 2, cx, cy, cz);
+
+        // cross(b, c), cross(c, a) and cross(a, b)
+        __m128 r0x = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+        __m128 r0y = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+        __m128 r0z = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+        __m128 r1x = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+        __m128 r1y = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+        __m128 r1z = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+        __m128 r2x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+        __m128 r2y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+        __m128 r2z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, r0x), _mm_mul_ps(ay, r0y)), _mm_mul_ps(az, r0z));
+        __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        __m128 p00, p01, p02, p03, p10, p11, p12, p13, p20, p21, p22, p23;
+        NormalMatrixPackColumn(_mm_mul_ps(r0x, inverseDet), _mm_mul_ps(r0y, inverseDet), _mm_mul_ps(r0z, inverseDet), p00, p01, p02, p03);
+        NormalMatrixPackColumn(_mm_mul_ps(r1x, inverseDet), _mm_mul_ps(r1y, inverseDet), _mm_mul_ps(r1z, inverseDet), p10, p11, p12, p13);
+        NormalMatrixPackColumn(_mm_mul_ps(r2x, inverseDet), _mm_mul_ps(r2y, inverseDet), _mm_mul_ps(r2z, inverseDet), p20, p21, p22, p23);
+
+        float* out = &normals[i][0][0];
+        NormalMatrixStoreColumns(out, p00, p10, p20);
+        NormalMatrixStoreColumns(out + 9, p01, p11, p21);
+        NormalMatrixStoreColumns(out + 18, p02, p12, p22);
+        NormalMatrixStoreLastColumns(out + 27, p03, p13, p23);
+    }
+#endif
+
+    // remaining matrices (or all of them when no vector unit is available)
+    NormalMatricesScalar(models + i, normals + i, count - i);
+}
+#endif
@@ -0,0 +1,183 @@
+#ifndef PARTICLE_COLLISIONS_H
+#define PARTICLE_COLLISIONS_H
+
+#include <learnopengl/philox.h>
+#include <learnopengl/particle_store.h>
+#include <learnopengl/particle_grid.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Random walk of hard spheres: the steps of RandomWalkStep, with the same random numbers, but a particle whose move
+// would bring it closer than two radii to another one, and closer than it was, stays where it is. The particles
+// no longer pass through each other, and the ones that overlap already (e.g. after the uniform initialization) can
+// still move apart.
+// The neighbors come from a ParticleGrid rebuilt every step, with cells wider than two radii plus two moves.
+// The particles move in place, in 8 passes over the cells, one per parity class of the cell coordinates: two cells
+// of a class have a whole cell between them, so no particle moved in a pass is a neighbor of another one moved in
+// the same pass, and the cells of a pass are spread over the threads without any race. Within a cell the particles
+// move in index order, so the walk is the same for any number of threads.
+// ------------------------------------------------------------------------
+class ParticleCollisions
+{
+public:
+    // of the last Step: time spent building the grid and moving the particles, and moves rejected by a collision
+    double buildSeconds;
+    double moveSeconds;
+    std::size_t rejected;
+
+    ParticleCollisions() : buildSeconds(0.0), moveSeconds(0.0), rejected(0), gridCells(-1)
+    {
+    }
+
+    // one step of every particle, of at most unit along each axis, within [-wall, wall]
+    void Step(ParticleStore& particles, const CounterRng& rng, ThreadPool& pool, float unit, float wall, float radius)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const std::size_t count = particles.Size();
+        const uint64_t step = particles.step;
+
+        Prepare(unit, wall, radius);
+        grid.Build(particles, pool);
+        bits.resize(count);
+        pool.ParallelFor(count, 4096, [this, &rng, step](std::size_t first, std::size_t last)
+        {
+            rng.GenerateBatch((uint32_t)first, last - first, step, PARTICLE_STREAM_WALK, &bits[first]);
+        });
+        std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now();
+
+        std::atomic<std::size_t> rejections(0);
+        const float contact2 = 4.0f * radius * radius;
+        for (int parity = 0; parity < 8; parity++)
+        {
+            const std::vector<uint32_t>& cells = parityCells[parity];
+            pool.ParallelFor(cells.size(), 16, [this, &particles, &cells, &rejections, unit, wall, contact2](std::size_t first, std::size_t last)
+            {
+                std::size_t local = 0;
+                for (std::size_t c = first; c < last; c++)
+                    local += MoveCell(particles, cells[c], unit, wall, contact2);
+                rejections += local;
+            });
+        }
+
+        particles.step++;
+        rejected = rejections.load();
+        buildSeconds = std::chrono::duration<double>(built - start).count();
+        moveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - built).count();
+    }
+
+    // pairs of particles closer than two radii, found through the grid
+    std::size_t Overlaps(const ParticleStore& particles, ThreadPool& pool, float wall, float radius)
+    {
+        grid.Resize(2.0f * radius, wall);
+        gridCells = -1;
+        grid.Build(particles, pool);
+
+        std::atomic<std::size_t> overlaps(0);
+        const float contact2 = 4.0f * radius * radius;
+        pool.ParallelFor(particles.Size(), 4096, [this, &particles, &overlaps, contact2](std::size_t first, std::size_t last)
+        {
+            std::size_t local = 0;
+            for (std::size_t i = first; i < last; i++)
+            {
+                const float x = particles.x[i], y = particles.y[i], z = particles.z[i];
+                grid.ForEachNeighbor(x, y, z, [&](uint32_t j)
+                {
+                    if (j <= i)
+                        return;
+                    float dx = particles.x[j] - x, dy = particles.y[j] - y, dz = particles.z[j] - z;
+                    if (dx * dx + dy * dy + dz * dz < contact2)
+                        local++;
+                });
+            }
+            overlaps += local;
+        });
+        return overlaps.load();
+    }
+
+private:
+    ParticleGrid grid;
+    // cells per axis the parity classes were made for, -1 if none
+    int gridCells;
+    std::vector<uint32_t> parityCells[8];
+    // random word of every particle for the current step
+    std::vector<uint32_t> bits;
+
+    // sizes the grid so that neighbors can only come from the 27 cells around a particle, even after the particles
+    // around it have moved in an earlier pass: a particle moves at most sqrt(3) * unit
+    void Prepare(float unit, float wall, float radius)
+    {
+        grid.Resize(2.0f * radius + 2.0f * std::sqrt(3.0f) * unit, wall);
+        const int n = grid.CellsPerAxis();
+        if (n == gridCells)
+            return;
+
+        gridCells = n;
+        for (int parity = 0; parity < 8; parity++)
+            parityCells[parity].clear();
+        for (int cz = 0; cz < n; cz++)
+            for (int cy = 0; cy < n; cy++)
+                for (int cx = 0; cx < n; cx++)
+                    parityCells[(cx & 1) | ((cy & 1) << 1) | ((cz & 1) << 2)].push_back(grid.CellIndex(cx, cy, cz));
+    }
+
+    // moves the particles of one cell, returns the moves rejected by a collision
+    std::size_t MoveCell(ParticleStore& particles, uint32_t cell, float unit, float wall, float contact2)
+    {
+        const uint32_t* indices = grid.Indices();
+        const int n = grid.CellsPerAxis();
+        const int cx = (int)(cell % n), cy = (int)(cell / n % n), cz = (int)(cell / n / n);
+        float* coords[3] = { particles.x.data(), particles.y.data(), particles.z.data() };
+
+        std::size_t collisions = 0;
+        for (uint32_t k = grid.CellStart(cell); k < grid.CellEnd(cell); k++)
+        {
+            const uint32_t i = indices[k];
+            float current[3], next[3];
+            bool moved = false;
+            for (int j = 0; j < 3; j++)
+            {
+                // same move as RandomWalkStepScalar
+                current[j] = next[j] = coords[j][i];
+                float step = ((bits[i] << j) & 0x80000000u) ? -unit : unit;
+                float candidate = current[j] + step;
+                if (candidate >= -wall && candidate <= wall)
+                {
+                    next[j] = candidate;
+                    moved = true;
+                }
+            }
+            if (!moved)
+                continue;
+
+            bool blocked = false;
+            grid.ForEachNeighborOfCell(cx, cy, cz, [&](uint32_t other)
+            {
+                if (blocked || other == i)
+                    return;
+                float nx = next[0] - coords[0][other], ny = next[1] - coords[1][other], nz = next[2] - coords[2][other];
+                float after = nx * nx + ny * ny + nz * nz;
+                if (after >= contact2)
+                    return;
+                float bx = current[0] - coords[0][other], by = current[1] - coords[1][other], bz = current[2] - coords[2][other];
+                if (after < bx * bx + by * by + bz * bz)
+                    blocked = true;
+            });
+
+            if (blocked)
+            {
+                collisions++;
+                continue;
+            }
+            for (int j = 0; j < 3; j++)
+                coords[j][i] = next[j];
+        }
+        return collisions;
+    }
+};
+#endif
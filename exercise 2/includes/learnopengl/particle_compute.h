@@ -0,0 +1,72 @@
+#ifndef PARTICLE_COMPUTE_H
+#define PARTICLE_COMPUTE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_c.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/philox.h>
+#include <learnopengl/particle_store.h>
+#include <learnopengl/particle_renderer.h>
+
+#include <cstdint>
+
+// GPU backend of the particle random walk: the particles live in the instance buffer of a ParticleRenderer, bound
+// as a shader storage buffer, and a compute shader (particle_step.cs) steps them where the instanced draw reads them,
+// so after the initial upload nothing goes through the CPU. The shader runs the same Philox generator on the same
+// counters as RandomWalkStep, so both backends walk the particles the same way.
+// Needs GL 4.3 for compute shaders; callers check Supported() first.
+// ------------------------------------------------------------------------
+class ParticleCompute
+{
+public:
+    // random walk steps taken so far, the step part of the random number counter (ParticleStore::step on the CPU)
+    uint64_t step;
+
+    ParticleCompute(const char* computePath) : step(0), shader(computePath), localSize(shader.localSizeX())
+    {
+    }
+
+    static bool Supported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // one random walk step of the particles uploaded to renderer, which then draws the new state as the latest
+    void Step(ParticleRenderer& renderer, const CounterRng& rng, float unit, float wall)
+    {
+        const unsigned int count = renderer.Instances();
+        if (count == 0)
+            return;
+
+        shader.use();
+        shader.setUInt("count", count);
+        shader.setUInt("capacity", renderer.Capacity());
+        shader.setUInt("readSlot", renderer.LatestSlot());
+        shader.setUInt("writeSlot", renderer.NextSlot());
+        shader.setUVec2("key", rng.key[0], rng.key[1]);
+        shader.setUVec2("stepIndex", (uint32_t)step, (uint32_t)(step >> 32));
+        shader.setUInt("stream", PARTICLE_STREAM_WALK);
+        shader.setFloat("unit", unit);
+        shader.setFloat("wall", wall);
+
+        GlobalGLState().BindStorageBase(0, renderer.instanceVBO);
+        glDispatchCompute((count + localSize - 1) / localSize, 1, 1);
+        // the next draw reads the buffer as vertex attributes, the next step as storage, and Download and the CPU
+        // upload after a reset read or write it through the buffer API
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        renderer.Advance();
+        step++;
+    }
+
+    void Delete()
+    {
+        GlobalGLState().DeleteProgram(shader.ID);
+    }
+
+private:
+    ComputeShader shader;
+    unsigned int localSize;
+};
+#endif
@@ -0,0 +1,185 @@
+#ifndef PARTICLE_GRID_H
+#define PARTICLE_GRID_H
+
+#include <learnopengl/particle_store.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over the particles of a ParticleStore, for neighbor queries. The cube [-extent, extent] is cut in
+// cells at least as wide as asked, and Build sorts the particle indices by cell with a counting sort, so that the
+// particles of a cell are one contiguous run of Indices(), from CellStart(cell) to CellEnd(cell).
+// A query no wider than a cell only has to look at the 27 cells around a point, see ForEachNeighbor.
+// The build is parallel: every thread counts one contiguous range of particles into its own histogram, and then
+// scatters its range after the ranges before it, so the order is the one of a serial stable sort whatever the
+// number of threads.
+// ------------------------------------------------------------------------
+class ParticleGrid
+{
+public:
+    // cells per axis are capped, so that a tiny cell size cannot ask for billions of cells
+    static const int MAX_CELLS_PER_AXIS = 512;
+
+    ParticleGrid() : extent(0.0f), cellSize(0.0f), inverseCellSize(0.0f), cellsPerAxis(0)
+    {
+    }
+
+    // makes cells of at least minimumCellSize over [-boxExtent, boxExtent]; particles outside the box are counted
+    // in the border cells
+    void Resize(float minimumCellSize, float boxExtent)
+    {
+        int cells = (int)(2.0f * boxExtent / minimumCellSize);
+        if (cells < 1)
+            cells = 1;
+        if (cells > MAX_CELLS_PER_AXIS)
+            cells = MAX_CELLS_PER_AXIS;
+
+        extent = boxExtent;
+        cellsPerAxis = cells;
+        cellSize = 2.0f * boxExtent / cells;
+        inverseCellSize = cells / (2.0f * boxExtent);
+        cellStart.assign(CellCount() + 1, 0);
+    }
+
+    // sorts the particles by cell; Resize must have been called
+    void Build(const ParticleStore& particles, ThreadPool& pool)
+    {
+        const std::size_t count = particles.Size();
+        const std::size_t cells = CellCount();
+        keys.resize(count);
+        indices.resize(count);
+
+        // one chunk of the pool per range, so that the chunk a thread gets tells which histogram is its own
+        const std::size_t ranges = pool.Size();
+        std::size_t grain = (count + ranges - 1) / ranges;
+        grain = ((grain + ThreadPool::CACHE_LINE_FLOATS - 1) / ThreadPool::CACHE_LINE_FLOATS) * ThreadPool::CACHE_LINE_FLOATS;
+        if (grain == 0)
+            grain = ThreadPool::CACHE_LINE_FLOATS;
+        histograms.resize(ranges * cells);
+
+        pool.ParallelFor(count, grain, [this, &particles, cells, grain](std::size_t first, std::size_t last)
+        {
+            uint32_t* histogram = &histograms[(first / grain) * cells];
+            std::fill(histogram, histogram + cells, 0u);
+            for (std::size_t i = first; i < last; i++)
+            {
+                uint32_t key = Cell(particles.x[i], particles.y[i], particles.z[i]);
+                keys[i] = key;
+                histogram[key]++;
+            }
+        });
+
+        // ranges past the last chunk (fewer particles than threads) hold nothing
+        const std::size_t used = count == 0 ? 0 : (count + grain - 1) / grain;
+        pool.ParallelFor(cells, 4096, [this, cells, used](std::size_t first, std::size_t last)
+        {
+            for (std::size_t cell = first; cell < last; cell++)
+            {
+                uint32_t total = 0;
+                for (std::size_t r = 0; r < used; r++)
+                    total += histograms[r * cells + cell];
+                cellStart[cell + 1] = total;
+            }
+        });
+        cellStart[0] = 0;
+        for (std::size_t cell = 0; cell < cells; cell++)
+            cellStart[cell + 1] += cellStart[cell];
+
+        // the histograms become the next free slot of every range in every cell
+        pool.ParallelFor(cells, 4096, [this, cells, used](std::size_t first, std::size_t last)
+        {
+            for (std::size_t cell = first; cell < last; cell++)
+            {
+                uint32_t offset = cellStart[cell];
+                for (std::size_t r = 0; r < used; r++)
+                {
+                    uint32_t counted = histograms[r * cells + cell];
+                    histograms[r * cells + cell] = offset;
+                    offset += counted;
+                }
+            }
+        });
+
+        pool.ParallelFor(count, grain, [this, cells, grain](std::size_t first, std::size_t last)
+        {
+            uint32_t* next = &histograms[(first / grain) * cells];
+            for (std::size_t i = first; i < last; i++)
+                indices[next[keys[i]]++] = (uint32_t)i;
+        });
+    }
+
+    unsigned int CellCount() const
+    {
+        return (unsigned int)(cellsPerAxis * cellsPerAxis * cellsPerAxis);
+    }
+
+    int CellsPerAxis() const { return cellsPerAxis; }
+    float CellSize() const { return cellSize; }
+
+    // coordinate of the cell holding a position along one axis, clamped to the grid
+    int CellCoordinate(float position) const
+    {
+        int c = (int)((position + extent) * inverseCellSize);
+        return c < 0 ? 0 : (c >= cellsPerAxis ? cellsPerAxis - 1 : c);
+    }
+
+    uint32_t CellIndex(int cx, int cy, int cz) const
+    {
+        return (uint32_t)((cz * cellsPerAxis + cy) * cellsPerAxis + cx);
+    }
+
+    uint32_t Cell(float x, float y, float z) const
+    {
+        return CellIndex(CellCoordinate(x), CellCoordinate(y), CellCoordinate(z));
+    }
+
+    // particle indices sorted by cell, and the run of each cell in them, as of the last Build
+    const uint32_t* Indices() const { return indices.data(); }
+    uint32_t CellStart(uint32_t cell) const { return cellStart[cell]; }
+    uint32_t CellEnd(uint32_t cell) const { return cellStart[cell + 1]; }
+    // cell of every particle at the last Build
+    uint32_t ParticleCell(std::size_t particle) const { return keys[particle]; }
+
+    // calls visit(index) for every particle of the cell holding (x, y, z) and of the cells around it: every particle
+    // (as of the last Build) within a cell size of the point, and some farther ones
+    template <typename Visit>
+    void ForEachNeighbor(float x, float y, float z, Visit visit) const
+    {
+        ForEachNeighborOfCell(CellCoordinate(x), CellCoordinate(y), CellCoordinate(z), visit);
+    }
+
+    template <typename Visit>
+    void ForEachNeighborOfCell(int cx, int cy, int cz, Visit visit) const
+    {
+        const int x0 = cx > 0 ? cx - 1 : 0, x1 = cx + 1 < cellsPerAxis ? cx + 1 : cx;
+        const int y0 = cy > 0 ? cy - 1 : 0, y1 = cy + 1 < cellsPerAxis ? cy + 1 : cy;
+        const int z0 = cz > 0 ? cz - 1 : 0, z1 = cz + 1 < cellsPerAxis ? cz + 1 : cz;
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int y = y0; y <= y1; y++)
+            {
+                // the cells of a row along x are consecutive, and so are their particles
+                const uint32_t first = cellStart[CellIndex(x0, y, z)];
+                const uint32_t last = cellStart[CellIndex(x1, y, z) + 1];
+                for (uint32_t k = first; k < last; k++)
+                    visit(indices[k]);
+            }
+        }
+    }
+
+private:
+    float extent;
+    float cellSize;
+    float inverseCellSize;
+    int cellsPerAxis;
+
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> cellStart;
+    // one row of CellCount() counters per range of particles
+    std::vector<uint32_t> histograms;
+};
+#endif
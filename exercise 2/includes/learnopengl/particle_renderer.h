@@ -0,0 +1,309 @@
+#ifndef PARTICLE_RENDERER_H
+#define PARTICLE_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/particle_store.h>
+#include <learnopengl/gl_state.h>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Draws every particle of a system with a single instanced call: the particle positions are streamed
+// into a per-instance attribute buffer that is hooked to the VAOs of the meshes (e.g. the levels of detail of a sphere)
+// that can be used for one particle.
+// The vertex shader reads two states, the latest uploaded one and the one before it, and interpolates between them.
+// The buffer is a ring of SLOTS states, each one mirroring the ParticleStore layout (all the x, then all the y,
+// then all the z). An upload writes the next slots of the ring, never the two the last draws read: a frame uploads
+// at most two states, so the ring lets the GPU be three frames behind before an upload has to wait. Fence, called
+// once the draws of the frame have been issued, marks the two slots they read; an upload coming back to a slot
+// waits on its fence, and then writes it through an unsynchronized mapping so the driver does not sync again.
+// The same buffer also feeds the impostor path, which draws one camera-facing quad per particle instead of a mesh.
+class ParticleRenderer
+{
+public:
+    static const unsigned int SLOTS = 6;
+
+    // first of the three attribute locations of the latest state (aOffsetX, aOffsetY, aOffsetZ)
+    static const unsigned int OFFSET_ATTRIBUTE = 2;
+    // first of the three attribute locations of the previous state (aPreviousX, aPreviousY, aPreviousZ)
+    static const unsigned int PREVIOUS_ATTRIBUTE = 5;
+
+    unsigned int instanceVBO;
+
+    // most particles the renderer can hold: a draw takes the instance count as a GLsizei, and the SLOTS states of
+    // the ring have to fit in one buffer, sized with a GLsizeiptr
+    static std::size_t MaxInstances()
+    {
+        const std::size_t drawn = (std::size_t)std::numeric_limits<GLsizei>::max();
+        const std::size_t stored = (std::size_t)std::numeric_limits<GLsizeiptr>::max() / (SLOTS * 3 * sizeof(float));
+        return drawn < stored ? drawn : stored;
+    }
+
+    ParticleRenderer() : instanceVBO(0), VAO(0), impostorVAO(0), indexCount(0), mode(GL_TRIANGLES), capacity(0), instances(0),
+                         current(0), previous(0), next(0)
+    {
+        for (unsigned int i = 0; i < SLOTS; i++)
+            fences[i] = 0;
+    }
+
+    // hooks the instance buffer to an indexed mesh (e.g. the sphere VAO) and makes it the one drawn;
+    // must be called once per mesh before drawing
+    void Attach(unsigned int meshVAO, unsigned int meshIndexCount, GLenum drawMode)
+    {
+        VAO = meshVAO;
+        indexCount = meshIndexCount;
+        mode = drawMode;
+
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+
+        meshVAOs.push_back(meshVAO);
+        EnableInstanceAttributes(meshVAO);
+        if (capacity > 0)
+        {
+            GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            SetInstancePointers(meshVAO);
+        }
+    }
+
+    // switches the mesh drawn by Draw to another attached one
+    void Select(unsigned int meshVAO, unsigned int meshIndexCount)
+    {
+        VAO = meshVAO;
+        indexCount = meshIndexCount;
+    }
+
+    // creates the VAO of the impostor path: it has no per-vertex attribute at all, the vertex shader
+    // builds the four quad corners from gl_VertexID; must be called once before DrawImpostors
+    void AttachImpostors()
+    {
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        if (impostorVAO == 0)
+            glGenVertexArrays(1, &impostorVAO);
+
+        EnableInstanceAttributes(impostorVAO);
+        if (capacity > 0)
+        {
+            GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            SetInstancePointers(impostorVAO);
+        }
+    }
+
+    // pushes a new state of the particles; the state uploaded before it becomes the previous one
+    void Upload(const ParticleStore& particles)
+    {
+        instances = (unsigned int)particles.Size();
+        if (instances == 0)
+            return;
+
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        bool allocated = false;
+        if (instances > capacity)
+        {
+            capacity = instances;
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)SLOTS * 3 * capacity * sizeof(float), NULL, GL_STREAM_DRAW);
+            ReleaseFences();
+            next = 0;
+            allocated = true;
+        }
+
+        unsigned int slot = Claim(true);
+        WriteSlot(slot, particles);
+        // with a new buffer there is nothing to interpolate from yet: the new state is also the previous one
+        previous = allocated ? slot : current;
+        current = slot;
+        SetAllInstancePointers();
+    }
+
+    // pushes the last two states of the particles at once, e.g. when several simulation steps ran since the last
+    // upload: the draw interpolates between exactly these two
+    void Upload(const ParticleStore& previous, const ParticleStore& latest)
+    {
+        Upload(previous);
+        Upload(latest);
+    }
+
+    // renders all the uploaded particles with one draw call
+    void Draw() const
+    {
+        if (instances == 0)
+            return;
+
+        GlobalGLState().BindVertexArray(VAO);
+        glDrawElementsInstanced(mode, indexCount, GL_UNSIGNED_INT, 0, instances);
+    }
+
+    // renders all the uploaded particles as quads, 4 vertices each, with one draw call
+    void DrawImpostors() const
+    {
+        if (instances == 0)
+            return;
+
+        GlobalGLState().BindVertexArray(impostorVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances);
+    }
+
+    // what Draw and DrawImpostors issue, for callers that record the draw (e.g. in a RenderQueue) instead
+    unsigned int VertexArray() const { return VAO; }
+    unsigned int ImpostorVertexArray() const { return impostorVAO; }
+    unsigned int IndexCount() const { return indexCount; }
+    GLenum Mode() const { return mode; }
+    unsigned int Instances() const { return instances; }
+
+    // floats in each plane of the instance buffer, the slot holding the latest state and the one the next state
+    // goes to: the buffer can also be written on the GPU (ParticleCompute), which reads the latest slot, writes the
+    // next one and then calls Advance
+    unsigned int Capacity() const { return capacity; }
+    unsigned int LatestSlot() const { return current; }
+    unsigned int NextSlot() const { return next; }
+
+    // makes the next slot, written on the GPU, the latest state, the latest one becoming the previous state;
+    // the GPU runs its commands in order, so there is no fence to wait on
+    void Advance()
+    {
+        previous = current;
+        current = Claim(false);
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        SetAllInstancePointers();
+    }
+
+    // marks the two slots read by the draws issued so far, so that no upload rewrites them before the GPU is done
+    void Fence()
+    {
+        if (instances == 0)
+            return;
+        SetFence(current);
+        if (previous != current)
+            SetFence(previous);
+    }
+
+    // reads the latest state back into particles, which must hold Instances() particles; stalls until the GPU is done
+    void Download(ParticleStore& particles) const
+    {
+        GLsizeiptr plane = (GLsizeiptr)instances * sizeof(float);
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glGetBufferSubData(GL_ARRAY_BUFFER, PlaneOffset(current, 0), plane, particles.x.data());
+        glGetBufferSubData(GL_ARRAY_BUFFER, PlaneOffset(current, 1), plane, particles.y.data());
+        glGetBufferSubData(GL_ARRAY_BUFFER, PlaneOffset(current, 2), plane, particles.z.data());
+    }
+
+    void Delete()
+    {
+        ReleaseFences();
+        GlobalGLState().DeleteBuffers(1, &instanceVBO);
+        GlobalGLState().DeleteVertexArrays(1, &impostorVAO);
+        instanceVBO = 0;
+        impostorVAO = 0;
+        meshVAOs.clear();
+        capacity = 0;
+        instances = 0;
+    }
+
+private:
+    unsigned int VAO;
+    unsigned int impostorVAO;
+    std::vector<unsigned int> meshVAOs;
+    unsigned int indexCount;
+    GLenum mode;
+    unsigned int capacity;
+    unsigned int instances;
+    // slots of the latest and the previous state, and the slot the next state goes to
+    unsigned int current;
+    unsigned int previous;
+    unsigned int next;
+    GLsync fences[SLOTS];
+
+    // the next slot of the ring; a slot the CPU is about to write first waits for the draws that read it
+    unsigned int Claim(bool cpuWrite)
+    {
+        unsigned int slot = next;
+        next = (next + 1) % SLOTS;
+        if (fences[slot] != 0)
+        {
+            if (cpuWrite)
+                while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                    ;
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+        return slot;
+    }
+
+    void SetFence(unsigned int slot)
+    {
+        if (fences[slot] != 0)
+            glDeleteSync(fences[slot]);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void ReleaseFences()
+    {
+        for (unsigned int i = 0; i < SLOTS; i++)
+        {
+            if (fences[i] != 0)
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    }
+
+    // the plane offsets depend on the capacity and on which slots hold the latest and the previous state;
+    // expects the instance buffer to be bound to GL_ARRAY_BUFFER
+    void SetAllInstancePointers()
+    {
+        for (unsigned int i = 0; i < meshVAOs.size(); i++)
+            SetInstancePointers(meshVAOs[i]);
+        if (impostorVAO != 0)
+            SetInstancePointers(impostorVAO);
+    }
+
+    void EnableInstanceAttributes(unsigned int vao)
+    {
+        GlobalGLState().BindVertexArray(vao);
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glEnableVertexAttribArray(OFFSET_ATTRIBUTE + i);
+            glEnableVertexAttribArray(PREVIOUS_ATTRIBUTE + i);
+            // advance the offsets once per instance instead of once per vertex
+            glVertexAttribDivisor(OFFSET_ATTRIBUTE + i, 1);
+            glVertexAttribDivisor(PREVIOUS_ATTRIBUTE + i, 1);
+        }
+        GlobalGLState().BindVertexArray(0);
+    }
+
+    // expects the instance buffer to be bound to GL_ARRAY_BUFFER
+    void SetInstancePointers(unsigned int vao)
+    {
+        GlobalGLState().BindVertexArray(vao);
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glVertexAttribPointer(OFFSET_ATTRIBUTE + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)PlaneOffset(current, i));
+            glVertexAttribPointer(PREVIOUS_ATTRIBUTE + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)PlaneOffset(previous, i));
+        }
+        GlobalGLState().BindVertexArray(0);
+    }
+
+    GLintptr PlaneOffset(unsigned int slot, unsigned int axis) const
+    {
+        return (GLintptr)(slot * 3 + axis) * capacity * sizeof(float);
+    }
+
+    // expects the instance buffer to be bound to GL_ARRAY_BUFFER, and the slot to be free (see Claim)
+    void WriteSlot(unsigned int slot, const ParticleStore& particles)
+    {
+        GLsizeiptr plane = (GLsizeiptr)instances * sizeof(float);
+        const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, PlaneOffset(slot, 0), PlaneOffset(slot, 3) - PlaneOffset(slot, 0), access);
+        if (mapped == NULL)
+            return;
+        const GLintptr stride = PlaneOffset(slot, 1) - PlaneOffset(slot, 0);
+        std::memcpy(mapped, particles.x.data(), plane);
+        std::memcpy(mapped + stride, particles.y.data(), plane);
+        std::memcpy(mapped + 2 * stride, particles.z.data(), plane);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+};
+#endif
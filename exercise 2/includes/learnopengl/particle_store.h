@@ -0,0 +1,211 @@
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include <learnopengl/philox.h>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLE_STORE_SSE2
+#endif
+
+// Allocator handing out storage aligned to a cache line, so that vector loads on the particle arrays never split a line.
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Structure-of-arrays particle storage: the x, y and z coordinates live in separate 64-byte aligned arrays,
+// so that a single vector instruction works on the same coordinate of 4, 8 or 16 consecutive particles.
+class ParticleStore
+{
+public:
+    std::vector<float, AlignedAllocator<float> > x;
+    std::vector<float, AlignedAllocator<float> > y;
+    std::vector<float, AlignedAllocator<float> > z;
+    // number of simulation steps taken so far, part of the random number counter
+    uint64_t step;
+
+    ParticleStore(std::size_t count = 0) : step(0)
+    {
+        Resize(count);
+    }
+
+    void Resize(std::size_t count)
+    {
+        x.resize(count, 0.0f);
+        y.resize(count, 0.0f);
+        z.resize(count, 0.0f);
+    }
+
+    std::size_t Size() const
+    {
+        return x.size();
+    }
+};
+
+// streams of the counter-based generator, so that initialization and random walk never share random numbers
+const uint32_t PARTICLE_STREAM_INIT = 0;
+const uint32_t PARTICLE_STREAM_WALK = 1;
+
+// Places every particle at a random position in [-extent, extent] on each axis.
+// Only depends on the seed, the particle index and the current step.
+// ------------------------------------------------------------------------
+inline void InitParticlesUniform(ParticleStore& particles, const CounterRng& rng, float extent)
+{
+    float* coords[3] = { particles.x.data(), particles.y.data(), particles.z.data() };
+
+    for (std::size_t i = 0; i < particles.Size(); i++)
+    {
+        uint32_t bits[4];
+        rng.Generate((uint32_t)i, particles.step, PARTICLE_STREAM_INIT, bits);
+
+        for (int j = 0; j < 3; j++)
+        {
+            float r = RandomUnitFloat(bits[j]) * extent;
+            coords[j][i] = (bits[3] & (1u << j)) ? -r : r;
+        }
+    }
+}
+
+// Random walk step: every coordinate moves by +unit or -unit with the same probability,
+// moves that would leave the [-wall, wall] box are rejected for that coordinate.
+// The sign of the x, y and z step comes from bit 31, 30 and 29 of the particle's random word for this step,
+// so any range of particles can be stepped independently (and on any thread) with the same result.
+// ------------------------------------------------------------------------
+inline void RandomWalkStepScalar(float* coords[3], const uint32_t* bits, std::size_t count, float unit, float wall)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            float step = ((bits[i] << j) & 0x80000000u) ? -unit : unit;
+            float next = coords[j][i] + step;
+            if (next >= -wall && next <= wall)
+                coords[j][i] = next;
+        }
+    }
+}
+
+inline void RandomWalkStepBlock(float* coords[3], const uint32_t* bits, std::size_t count, float unit, float wall)
+{
+    std::size_t i = 0;
+
+#if defined(__AVX512F__)
+    // 16 particles per instruction
+    const __m512 v_unit = _mm512_set1_ps(unit);
+    const __m512 v_wall = _mm512_set1_ps(wall);
+    const __m512 v_neg_wall = _mm512_set1_ps(-wall);
+    const __m512i sign_mask = _mm512_set1_epi32((int)0x80000000u);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i r = _mm512_loadu_si512((const void*)(bits + i));
+        for (int j = 0; j < 3; j++)
+        {
+            // move bit 31 - j into the float sign bit to get +unit or -unit without a branch
+            __m512i sign = _mm512_and_si512(_mm512_slli_epi32(r, j), sign_mask);
+            __m512 step = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v_unit), sign));
+            __m512 pos = _mm512_loadu_ps(coords[j] + i);
+            __m512 next = _mm512_add_ps(pos, step);
+            __mmask16 inside = _mm512_cmp_ps_mask(next, v_neg_wall, _CMP_GE_OQ) & _mm512_cmp_ps_mask(next, v_wall, _CMP_LE_OQ);
+            _mm512_storeu_ps(coords[j] + i, _mm512_mask_blend_ps(inside, pos, next));
+        }
+    }
+#elif defined(__AVX2__)
+    // 8 particles per instruction
+    const __m256 v_unit = _mm256_set1_ps(unit);
+    const __m256 v_wall = _mm256_set1_ps(wall);
+    const __m256 v_neg_wall = _mm256_set1_ps(-wall);
+    const __m256i sign_mask = _mm256_set1_epi32((int)0x80000000u);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i r = _mm256_loadu_si256((const __m256i*)(bits + i));
+        for (int j = 0; j < 3; j++)
+        {
+            // move bit 31 - j into the float sign bit to get +unit or -unit without a branch
+            __m256i sign = _mm256_and_si256(_mm256_slli_epi32(r, j), sign_mask);
+            __m256 step = _mm256_castsi256_ps(_mm256_xor_si256(_mm256_castps_si256(v_unit), sign));
+            __m256 pos = _mm256_loadu_ps(coords[j] + i);
+            __m256 next = _mm256_add_ps(pos, step);
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(next, v_neg_wall, _CMP_GE_OQ), _mm256_cmp_ps(next, v_wall, _CMP_LE_OQ));
+            _mm256_storeu_ps(coords[j] + i, _mm256_blendv_ps(pos, next, inside));
+        }
+    }
+#elif defined(PARTICLE_STORE_SSE2)
+    // 4 particles per instruction
+    const __m128 v_unit = _mm_set1_ps(unit);
+    const __m128 v_wall = _mm_set1_ps(wall);
+    const __m128 v_neg_wall = _mm_set1_ps(-wall);
+    const __m128i sign_mask = _mm_set1_epi32((int)0x80000000u);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i r = _mm_loadu_si128((const __m128i*)(bits + i));
+        for (int j = 0; j < 3; j++)
+        {
+            // move bit 31 - j into the float sign bit to get +unit or -unit without a branch
+            __m128i sign = _mm_and_si128(_mm_slli_epi32(r, j), sign_mask);
+            __m128 step = _mm_castsi128_ps(_mm_xor_si128(_mm_castps_si128(v_unit), sign));
+            __m128 pos = _mm_loadu_ps(coords[j] + i);
+            __m128 next = _mm_add_ps(pos, step);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(next, v_neg_wall), _mm_cmple_ps(next, v_wall));
+            _mm_storeu_ps(coords[j] + i, _mm_or_ps(_mm_and_ps(inside, next), _mm_andnot_ps(inside, pos)));
+        }
+    }
+#endif
+
+    // remaining particles (or all of them when no vector unit is available)
+    float* tail[3] = { coords[0] + i, coords[1] + i, coords[2] + i };
+    RandomWalkStepScalar(tail, bits + i, count - i, unit, wall);
+}
+
+// steps the particles [first, last) using the random numbers of the given step
+inline void RandomWalkStepRange(ParticleStore& particles, std::size_t first, std::size_t last, uint64_t step, const CounterRng& rng, float unit, float wall)
+{
+    // the random words are generated a block at a time, so they stay in L1 between generation and use
+    const std::size_t BLOCK = 256;
+    uint32_t bits[BLOCK];
+
+    for (std::size_t i = first; i < last; i += BLOCK)
+    {
+        std::size_t count = (last - i < BLOCK) ? last - i : BLOCK;
+        rng.GenerateBatch((uint32_t)i, count, step, PARTICLE_STREAM_WALK, bits);
+
+        float* coords[3] = { particles.x.data() + i, particles.y.data() + i, particles.z.data() + i };
+        RandomWalkStepBlock(coords, bits, count, unit, wall);
+    }
+}
+
+inline void RandomWalkStep(ParticleStore& particles, const CounterRng& rng, float unit, float wall)
+{
+    RandomWalkStepRange(particles, 0, particles.Size(), particles.step, rng, unit, wall);
+    particles.step++;
+}
+#endif
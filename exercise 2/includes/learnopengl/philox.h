@@ -0,0 +1,193 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Philox4x32-10 counter-based random number generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+// There is no hidden state: the output is a pure function of a 128-bit counter and a 64-bit key, so any
+// (particle, step) pair can be generated independently on any thread or SIMD lane, always with the same result.
+// ------------------------------------------------------------------------
+const uint32_t PHILOX_M0 = 0xD2511F53u;
+const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+const uint32_t PHILOX_W0 = 0x9E3779B9u;
+const uint32_t PHILOX_W1 = 0xBB67AE85u;
+const int PHILOX_ROUNDS = 10;
+
+inline void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n1 = (uint32_t)p1;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        uint32_t n3 = (uint32_t)p0;
+        c0 = n0; c1 = n1; c2 = n2; c3 = n3;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// Generator keyed by a seed. The counter is made of (index, step, stream): the index identifies the particle,
+// the step the simulation tick and the stream separates independent uses (e.g. initialization and random walk).
+// Bits() and GenerateBatch() hand out one 32-bit word per index; since a Philox block holds four words,
+// indices 4k..4k+3 share the block of counter k, which makes the batch API four times cheaper than one block per index.
+class CounterRng
+{
+public:
+    uint32_t key[2];
+
+    CounterRng(uint64_t seed = 0)
+    {
+        key[0] = (uint32_t)seed;
+        key[1] = (uint32_t)(seed >> 32);
+    }
+
+    // scalar API: the four 32-bit random words of one (counter, step, stream) block
+    void Generate(uint32_t counter, uint64_t step, uint32_t stream, uint32_t out[4]) const
+    {
+        uint32_t block[4] = { counter, (uint32_t)step, (uint32_t)(step >> 32), stream };
+        Philox4x32(block, key, out);
+    }
+
+    // one random word for the given index
+    uint32_t Bits(uint32_t index, uint64_t step, uint32_t stream) const
+    {
+        uint32_t out[4];
+        Generate(index >> 2, step, stream, out);
+        return out[index & 3];
+    }
+
+    // batch API: the random words for the indices [first, first + count) at the same step,
+    // bit-identical to calling Bits() on each index
+    void GenerateBatch(uint32_t first, std::size_t count, uint64_t step, uint32_t stream, uint32_t* out) const
+    {
+        std::size_t i = 0;
+        // leading indices up to the first whole block
+        for (; i < count && ((first + i) & 3) != 0; i++)
+            out[i] = Bits(first + (uint32_t)i, step, stream);
+
+        uint32_t counter = (first + (uint32_t)i) >> 2;
+#if defined(__AVX2__)
+        // 8 blocks, i.e. 32 words, per iteration
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (; i + 32 <= count; i += 32, counter += 8)
+        {
+            __m256i c[4];
+            Generate8(_mm256_add_epi32(_mm256_set1_epi32((int)counter), lane), step, stream, c);
+
+            // transpose from word-major (c[w] holds word w of the 8 blocks) to index order
+            __m256i t0 = _mm256_unpacklo_epi32(c[0], c[1]);
+            __m256i t1 = _mm256_unpacklo_epi32(c[2], c[3]);
+            __m256i t2 = _mm256_unpackhi_epi32(c[0], c[1]);
+            __m256i t3 = _mm256_unpackhi_epi32(c[2], c[3]);
+            __m256i b04 = _mm256_unpacklo_epi64(t0, t1);
+            __m256i b15 = _mm256_unpackhi_epi64(t0, t1);
+            __m256i b26 = _mm256_unpacklo_epi64(t2, t3);
+            __m256i b37 = _mm256_unpackhi_epi64(t2, t3);
+            _mm256_storeu_si256((__m256i*)(out + i + 0), _mm256_permute2x128_si256(b04, b15, 0x20));
+            _mm256_storeu_si256((__m256i*)(out + i + 8), _mm256_permute2x128_si256(b26, b37, 0x20));
+            _mm256_storeu_si256((__m256i*)(out + i + 16), _mm256_permute2x128_si256(b04, b15, 0x31));
+            _mm256_storeu_si256((__m256i*)(out + i + 24), _mm256_permute2x128_si256(b26, b37, 0x31));
+        }
+#endif
+        for (; i + 4 <= count; i += 4, counter++)
+            Generate(counter, step, stream, out + i);
+
+        for (; i < count; i++)
+            out[i] = Bits(first + (uint32_t)i, step, stream);
+    }
+
+#if defined(__AVX2__)
+    // eight Philox blocks at once: every lane holds its own counter, step and stream are shared
+    void Generate8(__m256i counter, uint64_t step, uint32_t stream, __m256i out[4]) const
+    {
+        const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+        const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+
+        __m256i c0 = counter;
+        __m256i c1 = _mm256_set1_epi32((int)(uint32_t)step);
+        __m256i c2 = _mm256_set1_epi32((int)(uint32_t)(step >> 32));
+        __m256i c3 = _mm256_set1_epi32((int)stream);
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for (int round = 0; round < PHILOX_ROUNDS; round++)
+        {
+            __m256i hi0 = MulHi(c0, m0);
+            __m256i lo0 = _mm256_mullo_epi32(c0, m0);
+            __m256i hi1 = MulHi(c2, m1);
+            __m256i lo1 = _mm256_mullo_epi32(c2, m1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+            c3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+private:
+    // high 32 bits of the 32x32 bit unsigned products, lane by lane
+    static __m256i MulHi(__m256i a, __m256i b)
+    {
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+        return _mm256_blend_epi32(even, odd, 0xAA);
+    }
+#endif
+};
+
+// known-answer test: the philox4x32-10 vectors of Random123 (kat_vectors), then GenerateBatch against Bits() over
+// ranges that start and end off a block boundary and cover the vector path. Cheap enough to run at every startup;
+// a failure means the compiler or a SIMD path broke the generator, and every "same result on any thread" claim with it.
+inline bool PhiloxSelfCheck()
+{
+    static const uint32_t vectors[3][10] = {
+        // counter[4], key[2], expected output[4]
+        { 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u,
+          0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u },
+        { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu,
+          0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu },
+        { 0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u, 0xa4093822u, 0x299f31d0u,
+          0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u } };
+    for (int v = 0; v < 3; v++)
+    {
+        uint32_t out[4];
+        Philox4x32(vectors[v], vectors[v] + 4, out);
+        for (int w = 0; w < 4; w++)
+            if (out[w] != vectors[v][6 + w])
+                return false;
+    }
+
+    const CounterRng rng(0x0123456789abcdefull);
+    const uint64_t step = 0x100000002ull;
+    uint32_t batch[80];
+    for (uint32_t first = 0; first < 5; first++)
+    {
+        rng.GenerateBatch(first, 75, step, 1, batch);
+        for (uint32_t i = 0; i < 75; i++)
+            if (batch[i] != rng.Bits(first + i, step, 1))
+                return false;
+    }
+    return true;
+}
+
+// maps a random word to a float uniformly distributed in [0, 1), using the 24 bits a float can hold exactly
+inline float RandomUnitFloat(uint32_t bits)
+{
+    return (float)(bits >> 8) * (1.0f / 16777216.0f);
+}
+#endif
@@ -0,0 +1,317 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/render_state.h>
+#include <learnopengl/uniform_blocks.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// One draw recorded in a RenderQueue: the program, render state and material it needs, its own uniforms and
+// its geometry. Uniforms shared by all the draws of a program (projection, view, ...) are not part of it, they
+// are set on the program before RenderQueue::Submit.
+struct RenderCommand
+{
+    // the uniforms of the command uploaded before its draw
+    enum Uniform { MODEL_UNIFORM = 1, NORMAL_MATRIX_UNIFORM = 2, ALPHA_UNIFORM = 4 };
+
+    Shader* shader;
+    const RenderState* state;
+    // layer drawn in order, 0 to 3: every draw of a pass comes before any draw of the next one
+    unsigned int pass;
+    // distance from the camera along the view direction
+    float depth;
+
+    // block bound before the draw, none if materials is NULL
+    const UniformBuffer<MaterialBlock>* materials;
+    unsigned int material;
+
+    unsigned int uniforms;
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+    float alpha;
+
+    // a mesh of a Model draws itself, with its own textures and vertex array; the geometry below is then unused
+    Mesh* mesh;
+    GLuint vertexArray;
+    GLenum mode;
+    // GL_NONE draws count vertices from first with glDrawArrays, an index type count indices from first with glDrawElements
+    GLenum indexType;
+    GLint first;
+    GLsizei count;
+    // 0 for a plain draw, the number of instances of an instanced one
+    GLsizei instances;
+
+    RenderCommand(Shader& commandShader, const RenderState& commandState, float commandDepth, unsigned int commandPass)
+        : shader(&commandShader), state(&commandState), pass(commandPass), depth(commandDepth), materials(NULL), material(0),
+          uniforms(0), model(1.0f), normalMatrix(1.0f), alpha(1.0f), mesh(NULL), vertexArray(0), mode(GL_TRIANGLES),
+          indexType(GL_NONE), first(0), count(0), instances(0)
+    {
+    }
+
+    // the setters return the command, so that a draw is recorded in a single statement
+    RenderCommand& SetMaterial(const UniformBuffer<MaterialBlock>& buffer, unsigned int index)
+    {
+        materials = &buffer;
+        material = index;
+        return *this;
+    }
+
+    RenderCommand& SetModel(const glm::mat4& matrix)
+    {
+        model = matrix;
+        uniforms |= MODEL_UNIFORM;
+        return *this;
+    }
+
+    RenderCommand& SetNormalMatrix(const glm::mat3& matrix)
+    {
+        normalMatrix = matrix;
+        uniforms |= NORMAL_MATRIX_UNIFORM;
+        return *this;
+    }
+
+    RenderCommand& SetAlpha(float value)
+    {
+        alpha = value;
+        uniforms |= ALPHA_UNIFORM;
+        return *this;
+    }
+
+    RenderCommand& SetArrays(GLuint arrays, GLenum drawMode, GLint firstVertex, GLsizei vertices, GLsizei drawInstances = 0)
+    {
+        vertexArray = arrays;
+        mode = drawMode;
+        indexType = GL_NONE;
+        first = firstVertex;
+        count = vertices;
+        instances = drawInstances;
+        return *this;
+    }
+
+    RenderCommand& SetElements(GLuint arrays, GLenum drawMode, GLsizei indices, GLenum type, GLsizei drawInstances = 0)
+    {
+        vertexArray = arrays;
+        mode = drawMode;
+        indexType = type;
+        first = 0;
+        count = indices;
+        instances = drawInstances;
+        return *this;
+    }
+
+    RenderCommand& SetMesh(Mesh& modelMesh)
+    {
+        mesh = &modelMesh;
+        return *this;
+    }
+
+    GLuint VertexArray() const
+    {
+        return mesh != NULL ? mesh->VAO : vertexArray;
+    }
+};
+
+// Draws of a frame, recorded in any order and submitted sorted by a 64-bit key:
+//   opaque:      pass (2 bits) | 0 | program (10) | material (10) | vertex array (12) | depth, near to far (29)
+//   translucent: pass (2 bits) | 1 | depth, far to near (29) | program (10) | material (10) | vertex array (12)
+// Within a pass the opaque draws come first, grouped by program, then material, then vertex array, so each of
+// them changes about as many times as there are distinct ones, whatever the number of draws; the near ones of a
+// group go first so that the depth test rejects what they hide. The translucent draws must be blended back to
+// front, so their depth comes before anything else. Program, material and vertex array names are only compared,
+// they wrap around the width of their field, which at worst splits a group in two.
+// The keys are sorted with an LSD radix sort, 8 bits per pass, skipping the digits all the keys share.
+// ------------------------------------------------------------------------
+class RenderQueue
+{
+public:
+    RenderQueue() : programChanges(0), vertexArrayChanges(0)
+    {
+    }
+
+    // distance of a point from the camera of view, along the view direction
+    static float ViewDepth(const glm::mat4& view, const glm::vec3& position)
+    {
+        return -(view[0][2] * position.x + view[1][2] * position.y + view[2][2] * position.z + view[3][2]);
+    }
+
+    void Clear()
+    {
+        commands.clear();
+    }
+
+    // records a draw with shader and state; the returned command is valid until the next Add
+    RenderCommand& Add(Shader& shader, const RenderState& state, float depth, unsigned int pass = 0)
+    {
+        commands.push_back(RenderCommand(shader, state, depth, pass));
+        return commands.back();
+    }
+
+    // sorts the recorded draws and issues them; the queue keeps them until Clear
+    void Submit()
+    {
+        Sort();
+
+        static constexpr UniformName MODEL_NAME("model");
+        static constexpr UniformName NORMAL_MATRIX_NAME("normalMatrix");
+        static constexpr UniformName ALPHA_NAME("alpha");
+
+        GLState& gl = GlobalGLState();
+        GLuint program = 0, vertexArray = 0;
+        programChanges = 0;
+        vertexArrayChanges = 0;
+        for (std::size_t i = 0; i < items.size(); i++)
+        {
+            RenderCommand& command = commands[items[i].command];
+            if (i == 0 || command.shader->ID != program)
+                programChanges++;
+            if (i == 0 || command.VertexArray() != vertexArray)
+                vertexArrayChanges++;
+            program = command.shader->ID;
+            vertexArray = command.VertexArray();
+
+            gl.Apply(*command.state);
+            command.shader->use();
+            if (command.materials != NULL)
+                command.materials->Bind(command.material);
+            if (command.uniforms & RenderCommand::MODEL_UNIFORM)
+                command.shader->setMat4(MODEL_NAME, command.model);
+            if (command.uniforms & RenderCommand::NORMAL_MATRIX_UNIFORM)
+                command.shader->setMat3(NORMAL_MATRIX_NAME, command.normalMatrix);
+            if (command.uniforms & RenderCommand::ALPHA_UNIFORM)
+                command.shader->setFloat(ALPHA_NAME, command.alpha);
+
+            if (command.mesh != NULL)
+            {
+                command.mesh->Draw(*command.shader);
+                continue;
+            }
+            gl.BindVertexArray(command.vertexArray);
+            if (command.indexType == GL_NONE)
+            {
+                if (command.instances > 0)
+                    glDrawArraysInstanced(command.mode, command.first, command.count, command.instances);
+                else
+                    glDrawArrays(command.mode, command.first, command.count);
+            }
+            else
+            {
+                const void* offset = (const void*)((std::size_t)command.first * IndexSize(command.indexType));
+                if (command.instances > 0)
+                    glDrawElementsInstanced(command.mode, command.count, command.indexType, offset, command.instances);
+                else
+                    glDrawElements(command.mode, command.count, command.indexType, offset);
+            }
+        }
+    }
+
+    // draws recorded since the last Clear
+    std::size_t Size() const { return commands.size(); }
+    // program and vertex array switches of the last Submit, counting the first draw
+    unsigned int ProgramChanges() const { return programChanges; }
+    unsigned int VertexArrayChanges() const { return vertexArrayChanges; }
+
+private:
+    static const unsigned int DEPTH_BITS = 29;
+    static const unsigned int PROGRAM_BITS = 10;
+    static const unsigned int MATERIAL_BITS = 10;
+    static const unsigned int VERTEX_ARRAY_BITS = 12;
+
+    struct Item
+    {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    std::vector<RenderCommand> commands;
+    std::vector<Item> items;
+    std::vector<Item> sorted;
+    unsigned int programChanges, vertexArrayChanges;
+
+    static std::size_t IndexSize(GLenum type)
+    {
+        return type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+    }
+
+    // the bits of a positive float compare like the float itself: dropping the sign bit, always 0, and the two
+    // lowest mantissa bits leaves a DEPTH_BITS integer in the same order
+    static uint64_t DepthKey(float depth)
+    {
+        if (!(depth > 0.0f))
+            return 0;
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - DEPTH_BITS);
+    }
+
+    static uint64_t Key(const RenderCommand& command)
+    {
+        const uint64_t program = command.shader->ID & ((1u << PROGRAM_BITS) - 1);
+        const uint64_t material = (command.materials != NULL ? command.material + 1 : 0) & ((1u << MATERIAL_BITS) - 1);
+        const uint64_t vertexArray = command.VertexArray() & ((1u << VERTEX_ARRAY_BITS) - 1);
+        const uint64_t depth = DepthKey(command.depth);
+
+        uint64_t key = (uint64_t)(command.pass & 3) << 62;
+        if (command.state->Blend())
+        {
+            const uint64_t farToNear = ((1ull << DEPTH_BITS) - 1) - depth;
+            key |= 1ull << 61;
+            key |= farToNear << (PROGRAM_BITS + MATERIAL_BITS + VERTEX_ARRAY_BITS);
+            key |= program << (MATERIAL_BITS + VERTEX_ARRAY_BITS);
+            key |= material << VERTEX_ARRAY_BITS;
+            key |= vertexArray;
+        }
+        else
+        {
+            key |= program << (MATERIAL_BITS + VERTEX_ARRAY_BITS + DEPTH_BITS);
+            key |= material << (VERTEX_ARRAY_BITS + DEPTH_BITS);
+            key |= vertexArray << DEPTH_BITS;
+            key |= depth;
+        }
+        return key;
+    }
+
+    // stable, so draws with the same key keep the order they were recorded in
+    void Sort()
+    {
+        const std::size_t n = commands.size();
+        items.resize(n);
+        sorted.resize(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            items[i].key = Key(commands[i]);
+            items[i].command = (uint32_t)i;
+        }
+        if (n < 2)
+            return;
+
+        for (unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            std::size_t offsets[256] = { 0 };
+            for (std::size_t i = 0; i < n; i++)
+                offsets[(items[i].key >> shift) & 0xFF]++;
+            if (offsets[(items[0].key >> shift) & 0xFF] == n)
+                continue;
+
+            std::size_t sum = 0;
+            for (unsigned int d = 0; d < 256; d++)
+            {
+                std::size_t digits = offsets[d];
+                offsets[d] = sum;
+                sum += digits;
+            }
+            for (std::size_t i = 0; i < n; i++)
+                sorted[offsets[(items[i].key >> shift) & 0xFF]++] = items[i];
+            items.swap(sorted);
+        }
+    }
+};
+#endif
@@ -0,0 +1,79 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include <glad/glad.h>
+
+// Fixed-function state a draw depends on: depth test and write, blending, polygon mode and face culling.
+// A RenderState is an immutable value: the With* methods return a modified copy, so a scene declares its few
+// states once (e.g. opaque, wire frame, transparent) and every draw names the one it needs. GLState::Apply then
+// changes only the fields that differ from the state of the previous draw, so the draws can be reordered freely
+// without one leaking its state into the next.
+// ------------------------------------------------------------------------
+class RenderState
+{
+public:
+    // the GL defaults, except for the depth test, which every draw of the exercises uses
+    RenderState()
+        : depthTest(true), depthWrite(true), depthFunc(GL_LESS), blend(false), blendSource(GL_ONE), blendDestination(GL_ZERO),
+          polygonMode(GL_FILL), cullFace(false), cullMode(GL_BACK)
+    {
+    }
+
+    RenderState WithDepth(bool test, bool write, GLenum func = GL_LESS) const
+    {
+        RenderState state(*this);
+        state.depthTest = test;
+        state.depthWrite = write;
+        state.depthFunc = func;
+        return state;
+    }
+
+    // blending off is written WithBlend(GL_ONE, GL_ZERO)
+    RenderState WithBlend(GLenum source, GLenum destination) const
+    {
+        RenderState state(*this);
+        state.blend = !(source == GL_ONE && destination == GL_ZERO);
+        state.blendSource = source;
+        state.blendDestination = destination;
+        return state;
+    }
+
+    // mode of both the front and the back faces
+    RenderState WithPolygonMode(GLenum mode) const
+    {
+        RenderState state(*this);
+        state.polygonMode = mode;
+        return state;
+    }
+
+    RenderState WithCulling(bool enabled, GLenum mode = GL_BACK) const
+    {
+        RenderState state(*this);
+        state.cullFace = enabled;
+        state.cullMode = mode;
+        return state;
+    }
+
+    bool DepthTest() const { return depthTest; }
+    bool DepthWrite() const { return depthWrite; }
+    GLenum DepthFunc() const { return depthFunc; }
+    bool Blend() const { return blend; }
+    GLenum BlendSource() const { return blendSource; }
+    GLenum BlendDestination() const { return blendDestination; }
+    GLenum PolygonMode() const { return polygonMode; }
+    bool CullFace() const { return cullFace; }
+    GLenum CullMode() const { return cullMode; }
+
+private:
+    friend class GLState;
+
+    bool depthTest;
+    bool depthWrite;
+    GLenum depthFunc;
+    bool blend;
+    GLenum blendSource, blendDestination;
+    GLenum polygonMode;
+    bool cullFace;
+    GLenum cullMode;
+};
+#endif
@@ -0,0 +1,123 @@
+#ifndef SCENE_NODE_H
+#define SCENE_NODE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Node of a transform hierarchy: a local position, rotation and scale relative to the parent node.
+// The world matrix is cached and only rebuilt when the node or one of its ancestors changed since the last
+// World() call, so a parent shared by many objects costs one matrix product per change instead of one per object.
+class SceneNode
+{
+public:
+    SceneNode(SceneNode* parent = NULL)
+        : position(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scale(1.0f), parent(NULL), world(1.0f), dirty(true)
+    {
+        SetParent(parent);
+    }
+
+    ~SceneNode()
+    {
+        SetParent(NULL);
+        for (unsigned int i = 0; i < children.size(); i++)
+            children[i]->parent = NULL;
+    }
+
+    void SetParent(SceneNode* newParent)
+    {
+        if (parent != NULL)
+            parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+        parent = newParent;
+        if (parent != NULL)
+            parent->children.push_back(this);
+        MarkDirty();
+    }
+
+    // the setters only invalidate the cached matrices when the value really changes
+    void SetPosition(const glm::vec3& value)
+    {
+        if (value != position)
+        {
+            position = value;
+            MarkDirty();
+        }
+    }
+
+    void SetRotation(const glm::quat& value)
+    {
+        if (value != rotation)
+        {
+            rotation = value;
+            MarkDirty();
+        }
+    }
+
+    void SetScale(const glm::vec3& value)
+    {
+        if (value != scale)
+        {
+            scale = value;
+            MarkDirty();
+        }
+    }
+
+    const glm::vec3& Position() const { return position; }
+    const glm::quat& Rotation() const { return rotation; }
+    const glm::vec3& Scale() const { return scale; }
+
+    // parent world matrix * translate(position) * rotate(rotation) * scale(scale)
+    const glm::mat4& World()
+    {
+        if (dirty)
+        {
+            glm::mat4 local = glm::mat4_cast(rotation);
+            local[0] *= scale.x;
+            local[1] *= scale.y;
+            local[2] *= scale.z;
+            local[3] = glm::vec4(position, 1.0f);
+
+            world = parent != NULL ? parent->World() * local : local;
+            dirty = false;
+        }
+        return world;
+    }
+
+    // world matrix of a leaf that is only translated by offset and uniformly scaled inside this node,
+    // i.e. World() * translate(offset) * scale(leafScale) without the two matrix products
+    glm::mat4 OffsetMatrix(const glm::vec3& offset, float leafScale)
+    {
+        const glm::mat4& m = World();
+        glm::mat4 result;
+        result[0] = m[0] * leafScale;
+        result[1] = m[1] * leafScale;
+        result[2] = m[2] * leafScale;
+        result[3] = m * glm::vec4(offset, 1.0f);
+        return result;
+    }
+
+private:
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+
+    SceneNode* parent;
+    std::vector<SceneNode*> children;
+
+    glm::mat4 world;
+    bool dirty;
+
+    // a clean node always has clean ancestors, so the walk can stop at the first node that is already dirty
+    void MarkDirty()
+    {
+        if (dirty)
+            return;
+        dirty = true;
+        for (unsigned int i = 0; i < children.size(); i++)
+            children[i]->MarkDirty();
+    }
+};
+#endif
@@ -0,0 +1,127 @@
+#ifndef COMPUTE_SHADER_H
+#define COMPUTE_SHADER_H
+
+#include <glad/glad.h>
+#include <learnopengl/uniform_cache.h>
+#include <learnopengl/gl_state.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// Program made of a single compute shader (GL 4.3), with the same uniform cache as Shader.
+class ComputeShader
+{
+public:
+    unsigned int ID;
+    // constructor generates the shader on the fly
+    // ------------------------------------------------------------------------
+    ComputeShader(const char* computePath)
+    {
+        // 1. retrieve the compute shader source code from filePath
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        // 2. compile shader
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        // shader Program
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        uniforms.Build(ID);
+        glDeleteShader(compute);
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() const
+    {
+        GlobalGLState().UseProgram(ID);
+    }
+    // local work group size declared by the shader, to size the dispatches
+    // ------------------------------------------------------------------------
+    unsigned int localSizeX() const
+    {
+        GLint size[3] = { 1, 1, 1 };
+        glGetProgramiv(ID, GL_COMPUTE_WORK_GROUP_SIZE, size);
+        return (unsigned int)size[0];
+    }
+    // utility uniform functions, skipping the upload when the uniform already holds the value
+    // ------------------------------------------------------------------------
+    void setInt(const UniformName &name, int value) const
+    {
+        UniformLocation location = uniforms.Find(ID, name);
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1i(location.value, value);
+    }
+    // ------------------------------------------------------------------------
+    void setUInt(const UniformName &name, unsigned int value) const
+    {
+        UniformLocation location = uniforms.Find(ID, name);
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1ui(location.value, value);
+    }
+    // ------------------------------------------------------------------------
+    void setUVec2(const UniformName &name, unsigned int x, unsigned int y) const
+    {
+        UniformLocation location = uniforms.Find(ID, name);
+        const unsigned int value[2] = { x, y };
+        if (uniforms.Changed(location, value, sizeof(value)))
+            glUniform2ui(location.value, x, y);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const UniformName &name, float value) const
+    {
+        UniformLocation location = uniforms.Find(ID, name);
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1f(location.value, value);
+    }
+
+private:
+    mutable UniformCache uniforms;
+
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    void checkCompileErrors(GLuint shader, std::string type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+    }
+};
+#endif
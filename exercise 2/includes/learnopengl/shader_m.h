@@ -2,6 +2,8 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <learnopengl/uniform_cache.h>
+#include <learnopengl/gl_state.h>
 #include <glm/glm.hpp>
 
 #include <string>
@@ -65,6 +67,8 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        // resolve the locations of all the active uniforms once, the setters then only look up a hash
+        uniforms.Build(ID);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -74,68 +78,133 @@ public:
     // ------------------------------------------------------------------------
     void use() const
     { 
-        glUseProgram(ID); 
+        GlobalGLState().UseProgram(ID); 
     }
-    // utility uniform functions
+    // location of a uniform, for the setters overloaded on UniformLocation that skip even the cache lookup
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    UniformLocation getUniformLocation(const UniformName &name) const
+    {
+        return uniforms.Find(ID, name);
     }
+    // utility uniform functions: by name they go through the location cache, by location they skip it;
+    // either way nothing is uploaded when the uniform already holds the value (see UniformCache::Changed)
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    void setBool(const UniformName &name, bool value) const
+    {
+        setBool(uniforms.Find(ID, name), value);
+    }
+    void setBool(UniformLocation location, bool value) const
+    {
+        setInt(location, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    void setInt(const UniformName &name, int value) const
+    {
+        setInt(uniforms.Find(ID, name), value);
+    }
+    void setInt(UniformLocation location, int value) const
+    {
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1i(location.value, value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setFloat(const UniformName &name, float value) const
+    {
+        setFloat(uniforms.Find(ID, name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    void setFloat(UniformLocation location, float value) const
+    {
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1f(location.value, value);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec2(const UniformName &name, const glm::vec2 &value) const
+    {
+        setVec2(uniforms.Find(ID, name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    void setVec2(UniformLocation location, const glm::vec2 &value) const
+    {
+        if (uniforms.Changed(location, &value[0], sizeof(value)))
+            glUniform2fv(location.value, 1, &value[0]);
+    }
+    void setVec2(const UniformName &name, float x, float y) const
+    {
+        setVec2(uniforms.Find(ID, name), x, y);
+    }
+    void setVec2(UniformLocation location, float x, float y) const
+    {
+        setVec2(location, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec3(const UniformName &name, const glm::vec3 &value) const
+    {
+        setVec3(uniforms.Find(ID, name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    void setVec3(UniformLocation location, const glm::vec3 &value) const
+    {
+        if (uniforms.Changed(location, &value[0], sizeof(value)))
+            glUniform3fv(location.value, 1, &value[0]);
+    }
+    void setVec3(const UniformName &name, float x, float y, float z) const
+    {
+        setVec3(uniforms.Find(ID, name), x, y, z);
+    }
+    void setVec3(UniformLocation location, float x, float y, float z) const
+    {
+        setVec3(location, glm::vec3(x, y, z));
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const UniformName &name, const glm::vec4 &value) const
+    {
+        setVec4(uniforms.Find(ID, name), value);
+    }
+    void setVec4(UniformLocation location, const glm::vec4 &value) const
+    {
+        if (uniforms.Changed(location, &value[0], sizeof(value)))
+            glUniform4fv(location.value, 1, &value[0]);
+    }
+    void setVec4(const UniformName &name, float x, float y, float z, float w) const
+    {
+        setVec4(uniforms.Find(ID, name), x, y, z, w);
+    }
+    void setVec4(UniformLocation location, float x, float y, float z, float w) const
+    {
+        setVec4(location, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const UniformName &name, const glm::mat2 &mat) const
+    {
+        setMat2(uniforms.Find(ID, name), mat);
+    }
+    void setMat2(UniformLocation location, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        if (uniforms.Changed(location, &mat[0][0], sizeof(mat)))
+            glUniformMatrix2fv(location.value, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const UniformName &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniforms.Find(ID, name), mat);
+    }
+    void setMat3(UniformLocation location, const glm::mat3 &mat) const
+    {
+        if (uniforms.Changed(location, &mat[0][0], sizeof(mat)))
+            glUniformMatrix3fv(location.value, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const UniformName &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniforms.Find(ID, name), mat);
+    }
+    void setMat4(UniformLocation location, const glm::mat4 &mat) const
+    {
+        if (uniforms.Changed(location, &mat[0][0], sizeof(mat)))
+            glUniformMatrix4fv(location.value, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    mutable UniformCache uniforms;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -2,6 +2,8 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <learnopengl/uniform_cache.h>
+#include <learnopengl/gl_state.h>
 
 #include <string>
 #include <fstream>
@@ -64,6 +66,8 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        // resolve the locations of all the active uniforms once, the setters then only look up a hash
+        uniforms.Build(ID);
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -72,26 +76,49 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GlobalGLState().UseProgram(ID); 
     }
-    // utility uniform functions
+    // location of a uniform, for the setters overloaded on UniformLocation that skip even the cache lookup
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    UniformLocation getUniformLocation(const UniformName &name) const
+    {
+        return uniforms.Find(ID, name);
     }
+    // utility uniform functions: by name they go through the location cache, by location they skip it;
+    // either way nothing is uploaded when the uniform already holds the value (see UniformCache::Changed)
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    void setBool(const UniformName &name, bool value) const
+    {
+        setBool(uniforms.Find(ID, name), value);
+    }
+    void setBool(UniformLocation location, bool value) const
+    {
+        setInt(location, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    void setInt(const UniformName &name, int value) const
+    {
+        setInt(uniforms.Find(ID, name), value);
+    }
+    void setInt(UniformLocation location, int value) const
+    {
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1i(location.value, value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const UniformName &name, float value) const
+    {
+        setFloat(uniforms.Find(ID, name), value);
+    }
+    void setFloat(UniformLocation location, float value) const
+    {
+        if (uniforms.Changed(location, &value, sizeof(value)))
+            glUniform1f(location.value, value);
     }
 
 private:
+    mutable UniformCache uniforms;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -0,0 +1,125 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <learnopengl/triple_buffer.h>
+#include <learnopengl/fixed_timestep.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+// Runs a simulation on its own thread at a fixed tick rate, decoupled from the render loop.
+// After every tick the state is published through a triple buffer: the render thread picks up the newest
+// snapshot with Acquire() without ever blocking, and a slow frame never slows the simulation down (or vice versa).
+// A snapshot holds the state of the tick and the one of the tick before it, so that the render thread can
+// interpolate between the last two ticks even when several of them ran since its last frame.
+// Ticks are paced by a FixedTimestep, so a tick that ran late is caught up (up to its catch-up limit).
+template <typename State>
+class SimulationThread
+{
+public:
+    typedef std::function<void(State&)> StepFunction;
+
+    SimulationThread(const State& initial, StepFunction stepFunction, double tickRate)
+        : state(initial), step(stepFunction), timestep(1.0 / tickRate), running(false), ticks(0)
+    {
+        Snapshot snapshot = { initial, initial, Clock::now() };
+        snapshots.Reset(snapshot);
+    }
+
+    ~SimulationThread()
+    {
+        Stop();
+    }
+
+    void Start()
+    {
+        if (running.exchange(true))
+            return;
+        thread = std::thread(&SimulationThread::Run, this);
+    }
+
+    void Stop()
+    {
+        if (!running.exchange(false))
+            return;
+        thread.join();
+    }
+
+    // render side: switches to the newest snapshot, returns true if it changed since the last call
+    bool Acquire()
+    {
+        return snapshots.Acquire();
+    }
+
+    // render side: the snapshot acquired last
+    const State& Latest() const
+    {
+        return snapshots.Front().state;
+    }
+
+    // render side: the state of the tick before the one of Latest()
+    const State& Previous() const
+    {
+        return snapshots.Front().previous;
+    }
+
+    // render side: how far the present is between the snapshot acquired last (0) and the next tick (1),
+    // i.e. the interpolation factor to use when the previous snapshot is blended with the latest one
+    float Alpha() const
+    {
+        double age = std::chrono::duration<double>(Clock::now() - snapshots.Front().time).count();
+        float alpha = (float)(age / timestep.Step());
+        return alpha < 1.0f ? alpha : 1.0f;
+    }
+
+    // number of ticks simulated so far
+    unsigned long long Ticks() const
+    {
+        return ticks.load(std::memory_order_relaxed);
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Snapshot
+    {
+        State state;
+        State previous;
+        Clock::time_point time;
+    };
+
+    State state;
+    StepFunction step;
+    FixedTimestep timestep;
+    TripleBuffer<Snapshot> snapshots;
+    std::atomic<bool> running;
+    std::atomic<unsigned long long> ticks;
+    std::thread thread;
+
+    void Run()
+    {
+        Clock::time_point last = Clock::now();
+        while (running.load())
+        {
+            Clock::time_point now = Clock::now();
+            unsigned int steps = timestep.Advance(std::chrono::duration<double>(now - last).count());
+            last = now;
+
+            for (unsigned int i = 0; i < steps && running.load(); i++)
+            {
+                Snapshot& back = snapshots.Back();
+                back.previous = state;
+                step(state);
+                back.state = state;
+                back.time = Clock::now();
+                snapshots.Publish();
+                ticks.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(timestep.Remaining()));
+        }
+    }
+};
+#endif
@@ -0,0 +1,395 @@
+#ifndef SPH_FLUID_H
+#define SPH_FLUID_H
+
+#include <learnopengl/particle_store.h>
+#include <learnopengl/particle_grid.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPH_FLUID_SSE2
+#endif
+
+// Smoothed-particle hydrodynamics of the particles of a ParticleStore, as a weakly compressible fluid in the box
+// [-wall, wall] under gravity along -y (Mueller et al. 2003): density with the poly6 kernel, pressure from a linear
+// equation of state (p = stiffness * (density - restDensity), no tension: negative pressures are dropped), symmetric
+// pressure forces with the spiky kernel gradient and viscosity with its laplacian, integrated with semi-implicit Euler.
+// The walls clamp the particles and reflect the normal velocity, damped by restitution.
+// Every step sorts the particles into a ParticleGrid with cells of one smoothing length and copies their positions
+// and velocities in grid order, so that the neighbors of a particle, and the particles processed one after the
+// other, are close in memory; the neighbor lists (particles within a smoothing length) are then gathered in one
+// pass, into one list per chunk of particles, 4 slots at a time with SSE2 and without a branch per slot (only about
+// one slot in 8 of the 27 cells is a neighbor). Every phase runs on the ThreadPool, all the state is kept as separate
+// arrays per coordinate, and only the integration writes back to the ParticleStore.
+// The resolution follows the particle count: InitDamBreak spaces the particles so that they fill a block of the box,
+// and the smoothing length and the particle mass follow that spacing.
+// ------------------------------------------------------------------------
+class SphFluid
+{
+public:
+    float restDensity;
+    // squared speed of sound: the larger, the less the fluid compresses, and the smaller the stable time step
+    float stiffness;
+    float viscosity;
+    float gravity;
+    // fraction of the normal velocity kept by a particle bouncing off a wall
+    float restitution;
+    // smoothing length in particle spacings
+    float smoothingRatio;
+
+    // set by InitDamBreak
+    float spacing;
+    float smoothingLength;
+    float particleMass;
+    float timeStep;
+
+    // of the last Step: grid and neighbor lists, density and pressure, forces, integration
+    double neighborSeconds;
+    double densitySeconds;
+    double forceSeconds;
+    double integrateSeconds;
+
+    SphFluid() : restDensity(1000.0f), stiffness(400.0f), viscosity(0.2f), gravity(9.81f), restitution(0.3f), smoothingRatio(2.0f),
+                 spacing(0.0f), smoothingLength(0.0f), particleMass(0.0f), timeStep(0.0f),
+                 neighborSeconds(0.0), densitySeconds(0.0), forceSeconds(0.0), integrateSeconds(0.0), neighborCount(0)
+    {
+    }
+
+    // places the particles at rest on a cubic lattice filling the x < 0 half of the box from the floor up (a dam
+    // about to break), and sizes the kernels and the time step to the lattice spacing
+    void InitDamBreak(ParticleStore& particles, float wall)
+    {
+        const std::size_t n = particles.Size();
+        Resize(n);
+        if (n == 0)
+            return;
+
+        // the block is wall wide, 2 * wall deep and up to 2 * wall high; the spacing shrinks until it holds them all
+        float s = std::cbrt(wall * 2.0f * wall * 1.5f * wall / n);
+        int nx = 0, nz = 0, ny = 0;
+        for (;; s *= 0.98f)
+        {
+            nx = (int)(wall / s);
+            nz = (int)(2.0f * wall / s);
+            ny = (int)(2.0f * wall / s);
+            if (nx > 0 && nz > 0 && (std::size_t)nx * nz * ny >= n)
+                break;
+        }
+
+        // layer by layer from the floor, so that an incomplete layer is the top one
+        std::size_t i = 0;
+        for (int y = 0; y < ny && i < n; y++)
+            for (int z = 0; z < nz && i < n; z++)
+                for (int x = 0; x < nx && i < n; x++, i++)
+                {
+                    particles.x[i] = -wall + (x + 0.5f) * s;
+                    particles.y[i] = -wall + (y + 0.5f) * s;
+                    particles.z[i] = -wall + (z + 0.5f) * s;
+                }
+
+        spacing = s;
+        smoothingLength = smoothingRatio * s;
+        particleMass = restDensity * s * s * s;
+        // CFL condition on the speed of sound
+        timeStep = 0.4f * smoothingLength / std::sqrt(stiffness);
+        for (std::size_t j = 0; j < n; j++)
+            vx[j] = vy[j] = vz[j] = 0.0f;
+    }
+
+    // one time step of the fluid in the box [-wall, wall]; InitDamBreak must have been called
+    void Step(ParticleStore& particles, ThreadPool& pool, float wall)
+    {
+        const std::size_t n = particles.Size();
+        if (vx.size() != n || smoothingLength <= 0.0f)
+            InitDamBreak(particles, wall);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BuildNeighbors(particles, pool, wall);
+        std::chrono::steady_clock::time_point neighbors = std::chrono::steady_clock::now();
+        ComputeDensities(pool);
+        std::chrono::steady_clock::time_point densities = std::chrono::steady_clock::now();
+        ComputeForces(pool);
+        std::chrono::steady_clock::time_point forces = std::chrono::steady_clock::now();
+        Integrate(particles, pool, wall);
+        std::chrono::steady_clock::time_point integrated = std::chrono::steady_clock::now();
+
+        neighborSeconds = std::chrono::duration<double>(neighbors - start).count();
+        densitySeconds = std::chrono::duration<double>(densities - neighbors).count();
+        forceSeconds = std::chrono::duration<double>(forces - densities).count();
+        integrateSeconds = std::chrono::duration<double>(integrated - forces).count();
+        particles.step++;
+    }
+
+    // neighbors per particle in the last Step, on average
+    double AverageNeighbors() const
+    {
+        return vx.empty() ? 0.0 : (double)neighborCount / vx.size();
+    }
+
+    // mean of |density / restDensity - 1| in the last Step
+    double DensityError() const
+    {
+        double error = 0.0;
+        for (std::size_t i = 0; i < density.size(); i++)
+            error += std::abs(density[i] / restDensity - 1.0f);
+        return density.empty() ? 0.0 : error / density.size();
+    }
+
+private:
+    typedef std::vector<float, AlignedAllocator<float> > FloatArray;
+
+    // particles of a chunk of the grid order, whose neighbor lists share one array
+    static const std::size_t CHUNK = 1024;
+
+    ParticleGrid grid;
+    // velocities by particle index
+    FloatArray vx, vy, vz;
+    // the rest is in grid order: slot k is particle grid.Indices()[k]
+    FloatArray px, py, pz;
+    FloatArray sortedVx, sortedVy, sortedVz;
+    FloatArray ax, ay, az;
+    FloatArray density, pressure;
+    // the neighbors of slot k, as slots, end at neighborEnd[k] in the list of its chunk and start where the ones of
+    // slot k - 1 end (at 0 for the first slot of a chunk)
+    std::vector<uint32_t> neighborEnd;
+    std::vector<std::vector<uint32_t> > chunkNeighbors;
+    std::size_t neighborCount;
+
+    void Resize(std::size_t n)
+    {
+        vx.assign(n, 0.0f);
+        vy.assign(n, 0.0f);
+        vz.assign(n, 0.0f);
+        px.resize(n);
+        py.resize(n);
+        pz.resize(n);
+        sortedVx.resize(n);
+        sortedVy.resize(n);
+        sortedVz.resize(n);
+        ax.resize(n);
+        ay.resize(n);
+        az.resize(n);
+        density.assign(n, 0.0f);
+        pressure.assign(n, 0.0f);
+        neighborEnd.assign(n, 0);
+        chunkNeighbors.resize((n + CHUNK - 1) / CHUNK);
+        neighborCount = 0;
+    }
+
+    // neighbor list of slot k
+    const uint32_t* NeighborsBegin(std::size_t k) const
+    {
+        return chunkNeighbors[k / CHUNK].data() + (k % CHUNK == 0 ? 0 : neighborEnd[k - 1]);
+    }
+    const uint32_t* NeighborsEnd(std::size_t k) const
+    {
+        return chunkNeighbors[k / CHUNK].data() + neighborEnd[k];
+    }
+
+    void BuildNeighbors(const ParticleStore& particles, ThreadPool& pool, float wall)
+    {
+        const std::size_t n = particles.Size();
+        const float h2 = smoothingLength * smoothingLength;
+        grid.Resize(smoothingLength, wall);
+        grid.Build(particles, pool);
+
+        const uint32_t* indices = grid.Indices();
+        pool.ParallelFor(n, 4096, [this, &particles, indices](std::size_t first, std::size_t last)
+        {
+            for (std::size_t k = first; k < last; k++)
+            {
+                const uint32_t i = indices[k];
+                px[k] = particles.x[i];
+                py[k] = particles.y[i];
+                pz[k] = particles.z[i];
+                sortedVx[k] = vx[i];
+                sortedVy[k] = vy[i];
+                sortedVz[k] = vz[i];
+            }
+        });
+
+        const int cells = grid.CellsPerAxis();
+        pool.ParallelFor(n, CHUNK, [this, h2, cells](std::size_t first, std::size_t last)
+        {
+            // a single thread gets the whole range in one call
+            for (std::size_t chunk = first; chunk < last; chunk += CHUNK)
+            {
+                std::vector<uint32_t>& list = chunkNeighbors[chunk / CHUNK];
+                uint32_t used = 0;
+                const std::size_t end = chunk + CHUNK < last ? chunk + CHUNK : last;
+                for (std::size_t k = chunk; k < end; k++)
+                {
+                    const float x = px[k], y = py[k], z = pz[k];
+                    const int cx = grid.CellCoordinate(x), cy = grid.CellCoordinate(y), cz = grid.CellCoordinate(z);
+                    const int x0 = cx > 0 ? cx - 1 : 0, x1 = cx + 1 < cells ? cx + 1 : cx;
+                    for (int gz = (cz > 0 ? cz - 1 : 0); gz <= (cz + 1 < cells ? cz + 1 : cz); gz++)
+                    {
+                        for (int gy = (cy > 0 ? cy - 1 : 0); gy <= (cy + 1 < cells ? cy + 1 : cy); gy++)
+                        {
+                            // a row of cells along x is one run of slots
+                            const uint32_t rowFirst = grid.CellStart(grid.CellIndex(x0, gy, gz));
+                            const uint32_t rowLast = grid.CellEnd(grid.CellIndex(x1, gy, gz));
+                            // room for every slot of the row, and a vector more, see GatherRow
+                            if (list.size() < used + (rowLast - rowFirst) + 4)
+                                list.resize(2 * (used + (rowLast - rowFirst) + 4));
+                            used = GatherRow(list.data(), used, rowFirst, rowLast, (uint32_t)k, x, y, z, h2);
+                        }
+                    }
+                    neighborEnd[k] = used;
+                }
+            }
+        });
+
+        neighborCount = 0;
+        for (std::size_t chunk = 0; chunk < n; chunk += CHUNK)
+            neighborCount += neighborEnd[(chunk + CHUNK < n ? chunk + CHUNK : n) - 1];
+    }
+
+    // appends to out, from used on, the slots of [first, last) other than self closer than sqrt(h2) to (x, y, z);
+    // returns the new end. Every slot of the range is written (and up to 4 past it), but used only advances past the
+    // neighbors, so that there is no branch on the distance test to mispredict: most of the slots of the 27 cells
+    // are not neighbors.
+    uint32_t GatherRow(uint32_t* out, uint32_t used, uint32_t first, uint32_t last, uint32_t self, float x, float y, float z, float h2) const
+    {
+        uint32_t j = first;
+
+#if defined(SPH_FLUID_SSE2)
+        // 4 slots per instruction; the lanes that pass are packed to the front with a table of offsets
+        static const uint32_t packed[16][4] = {
+            { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 },
+            { 2, 0, 0, 0 }, { 0, 2, 0, 0 }, { 1, 2, 0, 0 }, { 0, 1, 2, 0 },
+            { 3, 0, 0, 0 }, { 0, 3, 0, 0 }, { 1, 3, 0, 0 }, { 0, 1, 3, 0 },
+            { 2, 3, 0, 0 }, { 0, 2, 3, 0 }, { 1, 2, 3, 0 }, { 0, 1, 2, 3 } };
+        static const uint32_t passed[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+        const __m128 v_x = _mm_set1_ps(x), v_y = _mm_set1_ps(y), v_z = _mm_set1_ps(z), v_h2 = _mm_set1_ps(h2);
+        for (; j + 4 <= last; j += 4)
+        {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&px[j]), v_x);
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&py[j]), v_y);
+            const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&pz[j]), v_z);
+            const __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmplt_ps(r2, v_h2));
+            if (self - j < 4)
+                mask &= ~(1 << (self - j));
+            const __m128i offsets = _mm_loadu_si128((const __m128i*)packed[mask]);
+            _mm_storeu_si128((__m128i*)(out + used), _mm_add_epi32(_mm_set1_epi32((int)j), offsets));
+            used += passed[mask];
+        }
+#endif
+
+        // remaining slots (or all of them when no vector unit is available)
+        for (; j < last; j++)
+        {
+            const float dx = px[j] - x, dy = py[j] - y, dz = pz[j] - z;
+            out[used] = j;
+            used += (dx * dx + dy * dy + dz * dz < h2) & (j != self);
+        }
+        return used;
+    }
+
+    void ComputeDensities(ThreadPool& pool)
+    {
+        const float h = smoothingLength, h2 = h * h;
+        // poly6 kernel: 315 / (64 pi h^9) * (h^2 - r^2)^3
+        const float poly6 = particleMass * 315.0f / (64.0f * 3.14159265f * std::pow(h, 9.0f));
+        pool.ParallelFor(density.size(), CHUNK, [this, h2, poly6](std::size_t first, std::size_t last)
+        {
+            for (std::size_t k = first; k < last; k++)
+            {
+                // the particle itself counts, at r = 0
+                float sum = h2 * h2 * h2;
+                for (const uint32_t* j = NeighborsBegin(k); j != NeighborsEnd(k); j++)
+                {
+                    const float dx = px[*j] - px[k], dy = py[*j] - py[k], dz = pz[*j] - pz[k];
+                    const float w = h2 - (dx * dx + dy * dy + dz * dz);
+                    sum += w * w * w;
+                }
+                density[k] = poly6 * sum;
+                const float p = stiffness * (density[k] - restDensity);
+                pressure[k] = p > 0.0f ? p : 0.0f;
+            }
+        });
+    }
+
+    void ComputeForces(ThreadPool& pool)
+    {
+        const float h = smoothingLength;
+        // spiky gradient magnitude and viscosity laplacian: 45 / (pi h^6) * (h - r)^2 and 45 / (pi h^6) * (h - r)
+        const float kernel = 45.0f / (3.14159265f * std::pow(h, 6.0f));
+        pool.ParallelFor(density.size(), CHUNK, [this, h, kernel](std::size_t first, std::size_t last)
+        {
+            for (std::size_t k = first; k < last; k++)
+            {
+                float fx = 0.0f, fy = 0.0f, fz = 0.0f;
+                const float pk = pressure[k];
+                for (const uint32_t* n = NeighborsBegin(k); n != NeighborsEnd(k); n++)
+                {
+                    const uint32_t j = *n;
+                    float dx = px[k] - px[j], dy = py[k] - py[j], dz = pz[k] - pz[j];
+                    float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    const float q = h - r;
+                    // particles on top of each other push apart along an arbitrary, but symmetric, direction
+                    if (r < 1e-6f)
+                    {
+                        dx = k < j ? 1.0f : -1.0f;
+                        dy = dz = 0.0f;
+                        r = 1.0f;
+                    }
+                    const float rhoj = density[j];
+                    const float push = kernel * q * q * (pk + pressure[j]) / (2.0f * rhoj * r);
+                    const float drag = viscosity * kernel * q / rhoj;
+                    fx += push * dx + drag * (sortedVx[j] - sortedVx[k]);
+                    fy += push * dy + drag * (sortedVy[j] - sortedVy[k]);
+                    fz += push * dz + drag * (sortedVz[j] - sortedVz[k]);
+                }
+                const float scale = particleMass / density[k];
+                ax[k] = scale * fx;
+                ay[k] = scale * fy - gravity;
+                az[k] = scale * fz;
+            }
+        });
+    }
+
+    // writes the new positions and velocities back by particle index
+    void Integrate(ParticleStore& particles, ThreadPool& pool, float wall)
+    {
+        const float dt = timeStep;
+        const float bounce = restitution;
+        const uint32_t* indices = grid.Indices();
+        pool.ParallelFor(particles.Size(), 4096, [this, &particles, indices, dt, wall, bounce](std::size_t first, std::size_t last)
+        {
+            float* coords[3] = { particles.x.data(), particles.y.data(), particles.z.data() };
+            float* velocities[3] = { vx.data(), vy.data(), vz.data() };
+            const float* sortedCoords[3] = { px.data(), py.data(), pz.data() };
+            const float* sortedVelocities[3] = { sortedVx.data(), sortedVy.data(), sortedVz.data() };
+            const float* accelerations[3] = { ax.data(), ay.data(), az.data() };
+            for (int j = 0; j < 3; j++)
+            {
+                for (std::size_t k = first; k < last; k++)
+                {
+                    float v = sortedVelocities[j][k] + dt * accelerations[j][k];
+                    float p = sortedCoords[j][k] + dt * v;
+                    if (p > wall)
+                    {
+                        p = wall;
+                        v = v > 0.0f ? -bounce * v : v;
+                    }
+                    else if (p < -wall)
+                    {
+                        p = -wall;
+                        v = v < 0.0f ? -bounce * v : v;
+                    }
+                    velocities[j][indices[k]] = v;
+                    coords[j][indices[k]] = p;
+                }
+            }
+        });
+    }
+};
+#endif
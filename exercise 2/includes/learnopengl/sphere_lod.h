@@ -0,0 +1,182 @@
+#ifndef SPHERE_LOD_H
+#define SPHERE_LOD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cmath>
+#include <vector>
+
+// Chain of unit UV spheres with 4, 8, 16, 32 and 64 segments, built once and shared by every sphere in the scene.
+// Each object picks its level from the radius it covers on screen: the coarsest level whose silhouette deviates
+// from a true circle by less than maxErrorPixels, so small or far spheres shed most of their vertices while
+// close ones look the same as (or better than) a fixed tessellation.
+class SphereLod
+{
+public:
+    static const unsigned int LEVELS = 5;
+
+    unsigned int VAO[LEVELS];
+    unsigned int indexCount[LEVELS];
+    // largest distance, in pixels, allowed between the polygonal silhouette and the real sphere
+    float maxErrorPixels;
+
+    SphereLod(float maxError = 0.5f) : maxErrorPixels(maxError)
+    {
+        for (unsigned int i = 0; i < LEVELS; i++)
+        {
+            VAO[i] = 0;
+            indexCount[i] = 0;
+            buffers[i][0] = buffers[i][1] = 0;
+        }
+    }
+
+    // segments around the equator (and from pole to pole) of a level
+    static unsigned int Segments(unsigned int level)
+    {
+        return 4u << level;
+    }
+
+    // builds every level, does nothing if they already exist
+    void Build()
+    {
+        for (unsigned int i = 0; i < LEVELS; i++)
+            if (VAO[i] == 0)
+                BuildLevel(i);
+    }
+
+    // radius in pixels of a sphere seen through the given camera, or a huge value if the camera is inside it
+    static float ProjectedRadius(const glm::vec3& center, float radius, const glm::mat4& view, const glm::mat4& projection, float viewportHeight)
+    {
+        glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+        float distance2 = glm::dot(viewCenter, viewCenter) - radius * radius;
+        if (distance2 <= 0.0f)
+            return 1e30f;
+
+        // tangent of the half angle covered by the sphere, scaled by the focal length in pixels
+        return radius / std::sqrt(distance2) * projection[1][1] * 0.5f * viewportHeight;
+    }
+
+    // coarsest level whose silhouette error stays under maxErrorPixels
+    unsigned int SelectLevel(float radiusPixels) const
+    {
+        const float PI = 3.14159265359f;
+        for (unsigned int i = 0; i < LEVELS; i++)
+        {
+            // a chord of the n-gon drifts at most r * (1 - cos(pi / n)) from the circle
+            if (radiusPixels * (1.0f - std::cos(PI / Segments(i))) <= maxErrorPixels)
+                return i;
+        }
+        return LEVELS - 1;
+    }
+
+    unsigned int SelectLevel(const glm::vec3& center, float radius, const glm::mat4& view, const glm::mat4& projection, float viewportHeight) const
+    {
+        return SelectLevel(ProjectedRadius(center, radius, view, projection, viewportHeight));
+    }
+
+    void Draw(unsigned int level) const
+    {
+        GlobalGLState().BindVertexArray(VAO[level]);
+        glDrawElements(GL_TRIANGLE_STRIP, indexCount[level], GL_UNSIGNED_INT, 0);
+    }
+
+    // vertices (position and normal, interleaved) and triangle strip indices of a level, for callers that keep
+    // the sphere in buffers of their own
+    static void Geometry(unsigned int level, std::vector<float>& data, std::vector<unsigned int>& indices)
+    {
+        const unsigned int X_SEGMENTS = Segments(level);
+        const unsigned int Y_SEGMENTS = Segments(level);
+
+        std::vector<glm::vec3> positions;
+        data.clear();
+        indices.clear();
+
+        const float PI = 3.14159265359f;
+        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+        {
+            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+            {
+                float xSegment = (float)x / (float)X_SEGMENTS;
+                float ySegment = (float)y / (float)Y_SEGMENTS;
+                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+                float yPos = std::cos(ySegment * PI);
+                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+
+                positions.push_back(glm::vec3(xPos, yPos, zPos));
+            }
+        }
+
+        bool oddRow = false;
+        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+        {
+            if (!oddRow) // even rows: y == 0, y == 2; and so on
+            {
+                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+                {
+                    indices.push_back(y * (X_SEGMENTS + 1) + x);
+                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
+                }
+            }
+            else
+            {
+                for (int x = X_SEGMENTS; x >= 0; --x)
+                {
+                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
+                    indices.push_back(y * (X_SEGMENTS + 1) + x);
+                }
+            }
+            oddRow = !oddRow;
+        }
+        // on a unit sphere the normal is the position itself
+        for (unsigned int i = 0; i < positions.size(); ++i)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                data.push_back(positions[i].x);
+                data.push_back(positions[i].y);
+                data.push_back(positions[i].z);
+            }
+        }
+    }
+
+    void Delete()
+    {
+        for (unsigned int i = 0; i < LEVELS; i++)
+        {
+            GlobalGLState().DeleteVertexArrays(1, &VAO[i]);
+            GlobalGLState().DeleteBuffers(2, buffers[i]);
+            VAO[i] = 0;
+            indexCount[i] = 0;
+            buffers[i][0] = buffers[i][1] = 0;
+        }
+    }
+
+private:
+    unsigned int buffers[LEVELS][2];
+
+    void BuildLevel(unsigned int level)
+    {
+        std::vector<float> data;
+        std::vector<unsigned int> indices;
+        Geometry(level, data, indices);
+        indexCount[level] = (unsigned int)indices.size();
+
+        glGenVertexArrays(1, &VAO[level]);
+        glGenBuffers(2, buffers[level]);
+        GlobalGLState().BindVertexArray(VAO[level]);
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, buffers[level][0]);
+        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+        GlobalGLState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[level][1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        GLsizei stride = (3 + 3) * sizeof(float);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        GlobalGLState().BindVertexArray(0);
+    }
+};
+#endif
@@ -0,0 +1,228 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/streaming_buffer.h>
+
+#include <cstddef>
+#include <vector>
+
+// Layout of one draw in the GL_DRAW_INDIRECT_BUFFER read by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand layout does not match GL");
+
+// Data of one draw of a StaticScene, read by static_scene.vs as per-instance attributes.
+// A draw with two different materials is a checkerboard of them (the chessboard); with the same one it is plain.
+struct StaticDrawData
+{
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+    GLint materials[2];
+};
+
+// Static meshes kept in one shared vertex buffer (position and normal, interleaved) and one shared index buffer,
+// so that every draw of them uses the same vertex array. The draws of a frame are recorded with Add and issued
+// by Submit with a single glMultiDrawElementsIndirect, whatever their number. The commands and the per-draw data
+// are rewritten every frame through two StreamingBuffers.
+// GLSL 330 has no gl_DrawID, so the draw index goes in the baseInstance of each command instead: the per-draw data
+// are instanced attributes (divisor 1), and baseInstance makes draw i read element i of them.
+// Needs GL 4.3 for glMultiDrawElementsIndirect (and 4.2 for baseInstance); callers check Supported() first.
+// ------------------------------------------------------------------------
+class StaticScene
+{
+public:
+    // first of the attribute locations of the per-draw data: model (4 locations), normal matrix (3) and materials (1)
+    static const unsigned int MODEL_ATTRIBUTE = 2;
+    static const unsigned int NORMAL_MATRIX_ATTRIBUTE = 6;
+    static const unsigned int MATERIALS_ATTRIBUTE = 9;
+
+    // a range of the shared index buffer, always drawn as GL_TRIANGLES
+    struct Mesh
+    {
+        GLuint firstIndex;
+        GLuint count;
+        GLint baseVertex;
+    };
+
+    StaticScene() : VAO(0), VBO(0), EBO(0), submitted(0)
+    {
+    }
+
+    // true if the context has the entry points Submit relies on
+    static bool Supported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // appends a mesh of vertices (position and normal, 6 floats each) and triangle indices into them;
+    // the meshes are uploaded by Build, so they must all be added before it
+    unsigned int AddMesh(const std::vector<float>& meshVertices, const std::vector<unsigned int>& meshIndices)
+    {
+        Mesh mesh;
+        mesh.firstIndex = (GLuint)indices.size();
+        mesh.count = (GLuint)meshIndices.size();
+        mesh.baseVertex = (GLint)(vertices.size() / 6);
+        vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+        indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        meshes.push_back(mesh);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    // same, from the indices of a triangle strip; a multi-draw has one primitive mode for all its draws
+    unsigned int AddStripMesh(const std::vector<float>& meshVertices, const std::vector<unsigned int>& stripIndices)
+    {
+        std::vector<unsigned int> triangles;
+        for (std::size_t i = 2; i < stripIndices.size(); i++)
+        {
+            // every other triangle of a strip is wound the other way
+            unsigned int a = stripIndices[i - 2], b = stripIndices[i - 1], c = stripIndices[i];
+            if (a == b || b == c || a == c)
+                continue;
+            if (i % 2 == 0)
+            {
+                triangles.push_back(a);
+                triangles.push_back(b);
+            }
+            else
+            {
+                triangles.push_back(b);
+                triangles.push_back(a);
+            }
+            triangles.push_back(c);
+        }
+        return AddMesh(meshVertices, triangles);
+    }
+
+    // uploads the meshes and sets up the vertex array, with the per-draw data streamed with the given strategy;
+    // the CPU copies are dropped
+    void Build(StreamingStrategy strategy)
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        drawStream.Create(GL_ARRAY_BUFFER, 64 * sizeof(StaticDrawData), strategy);
+        indirectStream.Create(GL_DRAW_INDIRECT_BUFFER, 64 * sizeof(DrawElementsIndirectCommand), strategy);
+
+        GlobalGLState().BindVertexArray(VAO);
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+        GlobalGLState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+
+        GLsizei stride = (3 + 3) * sizeof(float);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+
+        // the per-draw data advance once per instance, and each draw has one instance starting at its own index;
+        // they are pointed at the streaming buffer by every Submit
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(MODEL_ATTRIBUTE + i);
+            glVertexAttribDivisor(MODEL_ATTRIBUTE + i, 1);
+        }
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glEnableVertexAttribArray(NORMAL_MATRIX_ATTRIBUTE + i);
+            glVertexAttribDivisor(NORMAL_MATRIX_ATTRIBUTE + i, 1);
+        }
+        glEnableVertexAttribArray(MATERIALS_ATTRIBUTE);
+        glVertexAttribDivisor(MATERIALS_ATTRIBUTE, 1);
+        GlobalGLState().BindVertexArray(0);
+
+        std::vector<float>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+    }
+
+    // forgets the draws of the last frame
+    void Clear()
+    {
+        commands.clear();
+        draws.clear();
+    }
+
+    // records a draw of a mesh added before Build
+    void Add(unsigned int mesh, const glm::mat4& model, const glm::mat3& normalMatrix, int material, int checkerMaterial = -1)
+    {
+        DrawElementsIndirectCommand command;
+        command.count = meshes[mesh].count;
+        command.instanceCount = 1;
+        command.firstIndex = meshes[mesh].firstIndex;
+        command.baseVertex = meshes[mesh].baseVertex;
+        command.baseInstance = (GLuint)draws.size();
+        commands.push_back(command);
+
+        StaticDrawData draw;
+        draw.model = model;
+        draw.normalMatrix = normalMatrix;
+        draw.materials[0] = material;
+        draw.materials[1] = checkerMaterial < 0 ? material : checkerMaterial;
+        draws.push_back(draw);
+    }
+
+    // uploads the recorded draws and issues all of them with one call; the program must be in use
+    void Submit()
+    {
+        submitted = (unsigned int)commands.size();
+        if (commands.empty())
+            return;
+
+        // the indirect buffer is read from its GL_DRAW_INDIRECT_BUFFER binding, which Write leaves in place
+        GLintptr drawOffset = drawStream.Write(&draws[0], draws.size() * sizeof(StaticDrawData));
+        GlobalGLState().BindVertexArray(VAO);
+        SetDrawPointers(drawOffset);
+        GLintptr commandOffset = indirectStream.Write(&commands[0], commands.size() * sizeof(DrawElementsIndirectCommand));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, (GLsizei)commands.size(), 0);
+        drawStream.Fence();
+        indirectStream.Fence();
+    }
+
+    // draws issued by the last Submit, all in a single call
+    unsigned int Submitted() const { return submitted; }
+
+    void Delete()
+    {
+        GlobalGLState().DeleteVertexArrays(1, &VAO);
+        GlobalGLState().DeleteBuffers(1, &VBO);
+        GlobalGLState().DeleteBuffers(1, &EBO);
+        drawStream.Delete();
+        indirectStream.Delete();
+        VAO = VBO = EBO = 0;
+        meshes.clear();
+        Clear();
+    }
+
+private:
+    unsigned int VAO, VBO, EBO;
+    StreamingBuffer drawStream, indirectStream;
+    unsigned int submitted;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Mesh> meshes;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<StaticDrawData> draws;
+
+    // expects the vertex array to be bound, and the per-draw stream to GL_ARRAY_BUFFER
+    void SetDrawPointers(GLintptr offset)
+    {
+        const GLsizei stride = sizeof(StaticDrawData);
+        for (unsigned int i = 0; i < 4; i++)
+            glVertexAttribPointer(MODEL_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(StaticDrawData, model) + i * sizeof(glm::vec4)));
+        for (unsigned int i = 0; i < 3; i++)
+            glVertexAttribPointer(NORMAL_MATRIX_ATTRIBUTE + i, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(StaticDrawData, normalMatrix) + i * sizeof(glm::vec3)));
+        glVertexAttribIPointer(MATERIALS_ATTRIBUTE, 2, GL_INT, stride, (void*)(offset + offsetof(StaticDrawData, materials)));
+    }
+};
+#endif
@@ -0,0 +1,216 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <chrono>
+#include <cstring>
+
+// How a StreamingBuffer gets new data to the GPU while draws issued earlier may still be reading the old data.
+enum StreamingStrategy
+{
+    // glBufferData(NULL) before every write: the driver hands out fresh storage and frees the old one once unused
+    STREAMING_ORPHAN,
+    // glBufferSubData into the next of REGIONS regions: the driver copies or waits if the GPU is still reading it
+    STREAMING_SUB_DATA,
+    // memcpy into a buffer mapped once for good (glBufferStorage, GL 4.4), the regions guarded by glFenceSync
+    STREAMING_PERSISTENT,
+    STREAMING_STRATEGIES
+};
+
+// Bytes written and time spent in StreamingBuffer::Write, counted since the last reset.
+struct StreamingCounters
+{
+    unsigned long long bytes;
+    // whole time of the writes, stalls included
+    double uploadSeconds;
+    // time spent waiting for the GPU before writing: the fence waits of the persistent strategy, 0 for the others,
+    // whose waits (if any) happen inside the driver and only show in uploadSeconds
+    double stallSeconds;
+
+    StreamingCounters() : bytes(0), uploadSeconds(0.0), stallSeconds(0.0)
+    {
+    }
+};
+
+// Buffer for data rewritten every frame (instance attributes, per-draw data, indirect commands), with the strategy
+// picked at creation. Write copies the data of the frame and returns the offset it landed at, which changes from a
+// frame to the next: the caller points its attributes (or its indirect draws) at that offset after each Write.
+// With the persistent strategy the buffer is split in REGIONS regions written in turn; Fence, called once the draws
+// reading a region have been issued, lets the write that comes back to it REGIONS frames later wait for the GPU only
+// if it is that far behind. Writes larger than a region grow the buffer, which can change its name (ID).
+// ------------------------------------------------------------------------
+class StreamingBuffer
+{
+public:
+    static const unsigned int REGIONS = 3;
+
+    unsigned int ID;
+
+    StreamingBuffer() : ID(0), target(GL_ARRAY_BUFFER), strategy(STREAMING_ORPHAN), regionSize(0), region(0), mapped(NULL)
+    {
+        for (unsigned int i = 0; i < REGIONS; i++)
+            fences[i] = 0;
+    }
+
+    // the persistent strategy needs glBufferStorage
+    static bool Supported(StreamingStrategy streamingStrategy)
+    {
+        return streamingStrategy != STREAMING_PERSISTENT || GLAD_GL_VERSION_4_4 != 0;
+    }
+
+    static const char* Name(StreamingStrategy streamingStrategy)
+    {
+        switch (streamingStrategy)
+        {
+        case STREAMING_ORPHAN: return "orphan";
+        case STREAMING_SUB_DATA: return "subdata";
+        case STREAMING_PERSISTENT: return "persistent";
+        default: return "unknown";
+        }
+    }
+
+    // a strategy from its Name, fallback if there is none with that name
+    static StreamingStrategy Parse(const char* name, StreamingStrategy fallback)
+    {
+        for (int i = 0; i < STREAMING_STRATEGIES; i++)
+            if (std::strcmp(name, Name((StreamingStrategy)i)) == 0)
+                return (StreamingStrategy)i;
+        return fallback;
+    }
+
+    // an unsupported strategy falls back to glBufferSubData
+    void Create(GLenum bufferTarget, GLsizeiptr size, StreamingStrategy streamingStrategy)
+    {
+        Delete();
+        target = bufferTarget;
+        strategy = Supported(streamingStrategy) ? streamingStrategy : STREAMING_SUB_DATA;
+        if (size > 0)
+            Allocate(size);
+    }
+
+    StreamingStrategy Strategy() const { return strategy; }
+
+    // copies size bytes into the buffer and returns their offset; leaves the buffer bound to its target
+    GLintptr Write(const void* data, GLsizeiptr size)
+    {
+        if (size <= 0)
+            return 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        StreamingCounters& counters = Counters();
+
+        if (size > regionSize)
+        {
+            GLsizeiptr grown = regionSize * 2;
+            Allocate(grown > size ? grown : size);
+        }
+
+        GLintptr offset = 0;
+        GlobalGLState().BindBuffer(target, ID);
+        if (strategy == STREAMING_ORPHAN)
+        {
+            glBufferData(target, regionSize, NULL, GL_STREAM_DRAW);
+            glBufferSubData(target, 0, size, data);
+        }
+        else
+        {
+            region = (region + 1) % REGIONS;
+            offset = region * regionSize;
+            if (strategy == STREAMING_SUB_DATA)
+                glBufferSubData(target, offset, size, data);
+            else
+            {
+                if (fences[region] != 0)
+                {
+                    std::chrono::steady_clock::time_point wait = std::chrono::steady_clock::now();
+                    while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                        ;
+                    glDeleteSync(fences[region]);
+                    fences[region] = 0;
+                    counters.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait).count();
+                }
+                std::memcpy(mapped + offset, data, size);
+            }
+        }
+
+        counters.bytes += size;
+        counters.uploadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return offset;
+    }
+
+    // marks the region of the last Write as in use by the draws issued so far
+    void Fence()
+    {
+        if (strategy != STREAMING_PERSISTENT)
+            return;
+        if (fences[region] != 0)
+            glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void Delete()
+    {
+        Release();
+        regionSize = 0;
+        region = 0;
+    }
+
+    // the writes of every streaming buffer of the program
+    static StreamingCounters& Counters()
+    {
+        static StreamingCounters counters;
+        return counters;
+    }
+
+private:
+    GLenum target;
+    StreamingStrategy strategy;
+    GLsizeiptr regionSize;
+    unsigned int region;
+    unsigned char* mapped;
+    GLsync fences[REGIONS];
+
+    void Allocate(GLsizeiptr size)
+    {
+        // storage made with glBufferStorage is immutable, so growing a persistent buffer means a new buffer
+        Release();
+        regionSize = size;
+        region = 0;
+
+        glGenBuffers(1, &ID);
+        GlobalGLState().BindBuffer(target, ID);
+        if (strategy == STREAMING_ORPHAN)
+            glBufferData(target, regionSize, NULL, GL_STREAM_DRAW);
+        else if (strategy == STREAMING_SUB_DATA)
+            glBufferData(target, REGIONS * regionSize, NULL, GL_STREAM_DRAW);
+        else
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, REGIONS * regionSize, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(target, 0, REGIONS * regionSize, flags);
+        }
+    }
+
+    void Release()
+    {
+        for (unsigned int i = 0; i < REGIONS; i++)
+        {
+            if (fences[i] != 0)
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        if (ID == 0)
+            return;
+        if (mapped != NULL)
+        {
+            GlobalGLState().BindBuffer(target, ID);
+            glUnmapBuffer(target);
+            mapped = NULL;
+        }
+        GlobalGLState().DeleteBuffers(1, &ID);
+        ID = 0;
+    }
+};
+#endif
@@ -0,0 +1,185 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for data-parallel loops.
+// ParallelFor splits a range into chunks and deals them out to one queue per thread (the calling thread included);
+// every thread drains its own queue from the front and, once it is empty, steals from the back of the others,
+// so a thread that is slowed down (or preempted) does not hold the whole loop back.
+class ThreadPool
+{
+public:
+    typedef std::function<void(std::size_t, std::size_t)> Body;
+
+    // number of floats in a 64-byte cache line: chunk boundaries are multiples of it, so with aligned arrays
+    // two threads never write to the same cache line
+    static const std::size_t CACHE_LINE_FLOATS = 16;
+
+    // threads is the total number of threads working on a loop, including the one calling ParallelFor
+    explicit ThreadPool(unsigned int threads = 0) : generation(0), stopping(false), pending(0)
+    {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+
+        for (unsigned int i = 0; i < threads; i++)
+            queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        for (unsigned int i = 1; i < threads; i++)
+            workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)queues.size();
+    }
+
+    // calls body(begin, end) on chunks covering [0, count) and returns once all of them are done;
+    // grain is the preferred chunk size, rounded up to whole cache lines
+    void ParallelFor(std::size_t count, std::size_t grain, const Body& body)
+    {
+        if (count == 0)
+            return;
+
+        grain = ((grain + CACHE_LINE_FLOATS - 1) / CACHE_LINE_FLOATS) * CACHE_LINE_FLOATS;
+        if (grain == 0)
+            grain = CACHE_LINE_FLOATS;
+
+        std::size_t chunks = (count + grain - 1) / grain;
+        if (queues.size() == 1 || chunks == 1)
+        {
+            body(0, count);
+            return;
+        }
+
+        // contiguous runs of chunks per thread, so that without stealing every thread walks its own part of memory
+        pending.store(chunks);
+        std::size_t threads = queues.size();
+        for (std::size_t t = 0; t < threads; t++)
+        {
+            std::size_t first = chunks * t / threads;
+            std::size_t last = chunks * (t + 1) / threads;
+
+            std::lock_guard<std::mutex> lock(queues[t]->mutex);
+            for (std::size_t c = first; c < last; c++)
+            {
+                Chunk chunk = { c * grain, (c + 1) * grain < count ? (c + 1) * grain : count, &body };
+                queues[t]->chunks.push_back(chunk);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+        }
+        wake.notify_all();
+
+        RunChunks(0);
+
+        // the remaining chunks are being run by other threads
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending.load() == 0; });
+    }
+
+private:
+    struct Chunk
+    {
+        std::size_t begin;
+        std::size_t end;
+        const Body* body;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long long generation;
+    bool stopping;
+    std::atomic<std::size_t> pending;
+
+    bool PopOwn(std::size_t self, Chunk& chunk)
+    {
+        std::lock_guard<std::mutex> lock(queues[self]->mutex);
+        if (queues[self]->chunks.empty())
+            return false;
+        chunk = queues[self]->chunks.front();
+        queues[self]->chunks.pop_front();
+        return true;
+    }
+
+    bool Steal(std::size_t self, Chunk& chunk)
+    {
+        for (std::size_t i = 1; i < queues.size(); i++)
+        {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.chunks.empty())
+            {
+                chunk = victim.chunks.back();
+                victim.chunks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void RunChunks(std::size_t self)
+    {
+        Chunk chunk;
+        while (PopOwn(self, chunk) || Steal(self, chunk))
+        {
+            (*chunk.body)(chunk.begin, chunk.end);
+            if (pending.fetch_sub(1) == 1)
+            {
+                // last chunk of the loop: wake up the thread waiting in ParallelFor
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    void WorkerLoop(std::size_t self)
+    {
+        unsigned long long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            RunChunks(self);
+        }
+    }
+};
+#endif
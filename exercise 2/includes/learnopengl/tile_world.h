@@ -0,0 +1,257 @@
+#ifndef TILE_WORLD_H
+#define TILE_WORLD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <vector>
+
+// Colors of one kind of tile, indexed by the tile map of a TileWorld.
+struct TileMaterial
+{
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+
+    TileMaterial(const glm::vec3& tileAmbient = glm::vec3(0.0f), const glm::vec3& tileDiffuse = glm::vec3(0.0f))
+        : ambient(tileAmbient), diffuse(tileDiffuse)
+    {
+    }
+};
+
+// Renderer of a flat map of square tiles on the xz plane (y = 0), each tile with its own material.
+// The map is split in chunks of CHUNK_TILES x CHUNK_TILES tiles, every chunk with static vertex buffers and a bounding
+// box: chunks outside the view frustum are not submitted, and the others are drawn with one glDrawElements each.
+// A chunk has LEVELS versions of its geometry, level k merging 2^k x 2^k tiles in a single quad with their average color;
+// every chunk picks the coarsest level whose merged cells stay under maxCellPixels on screen, where the average is
+// what the pixel would show anyway. The coarsest level (one quad per chunk) is built up front, finer levels the
+// first time a chunk needs them, at most maxBuildsPerFrame per frame, so memory follows the part of the map
+// that has been seen up close rather than its size.
+class TileWorld
+{
+public:
+    static const unsigned int CHUNK_TILES = 64;
+    static const unsigned int LEVELS = 7;
+
+    // largest side, in pixels, of a merged cell before the chunk switches to a finer level
+    float maxCellPixels;
+    // finer levels built in a single Draw, a chunk lacking its level meanwhile uses the nearest coarser one
+    unsigned int maxBuildsPerFrame;
+
+    TileWorld(float maxCell = 1.0f, unsigned int maxBuilds = 8)
+        : maxCellPixels(maxCell), maxBuildsPerFrame(maxBuilds), tilesX(0), tilesZ(0), origin(0.0f), tileSize(1.0f),
+          EBO(0), chunksDrawn(0), cellsDrawn(0)
+    {
+    }
+
+    // tiles holds tilesX * tilesZ indices into palette, the tile (i, j) at tiles[j * tilesX + i] covering
+    // [origin + (i, j) * size, origin + (i + 1, j + 1) * size] on the xz plane
+    void Build(unsigned int mapTilesX, unsigned int mapTilesZ, const glm::vec2& mapOrigin, float size,
+               const std::vector<unsigned char>& mapTiles, const std::vector<TileMaterial>& mapPalette)
+    {
+        Delete();
+        tilesX = mapTilesX;
+        tilesZ = mapTilesZ;
+        origin = mapOrigin;
+        tileSize = size;
+        tiles = mapTiles;
+        palette = mapPalette;
+
+        // the quads of a chunk are always 4 consecutive vertices, so every chunk and level shares one index buffer
+        std::vector<GLushort> indices;
+        indices.reserve(CHUNK_TILES * CHUNK_TILES * 6);
+        for (unsigned int q = 0; q < CHUNK_TILES * CHUNK_TILES; q++)
+        {
+            const GLushort quad[] = { 0, 1, 2, 2, 3, 0 };
+            for (int k = 0; k < 6; k++)
+                indices.push_back((GLushort)(q * 4 + quad[k]));
+        }
+        // uploaded through GL_ARRAY_BUFFER so that no vertex array object of the caller picks it up
+        glGenBuffers(1, &EBO);
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+
+        for (unsigned int z = 0; z < tilesZ; z += CHUNK_TILES)
+        {
+            for (unsigned int x = 0; x < tilesX; x += CHUNK_TILES)
+            {
+                Chunk chunk;
+                chunk.tileX = x;
+                chunk.tileZ = z;
+                chunk.tilesX = std::min(CHUNK_TILES, tilesX - x);
+                chunk.tilesZ = std::min(CHUNK_TILES, tilesZ - z);
+                chunk.boundsMin = glm::vec3(origin.x + x * tileSize, 0.0f, origin.y + z * tileSize);
+                chunk.boundsMax = glm::vec3(origin.x + (x + chunk.tilesX) * tileSize, 0.0f, origin.y + (z + chunk.tilesZ) * tileSize);
+                for (unsigned int l = 0; l < LEVELS; l++)
+                    chunk.VAO[l] = chunk.VBO[l] = chunk.cells[l] = 0;
+                chunks.push_back(chunk);
+                BuildLevel(chunks.back(), LEVELS - 1);
+            }
+        }
+    }
+
+    // draws the chunks in the frustum of projection * view, returns how many
+    unsigned int Draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition, float viewportHeight)
+    {
+        Frustum frustum(projection * view);
+        // pixels covered by one world unit at distance 1
+        float focal = projection[1][1] * 0.5f * viewportHeight;
+        unsigned int builds = 0;
+
+        chunksDrawn = 0;
+        cellsDrawn = 0;
+        for (unsigned int c = 0; c < chunks.size(); c++)
+        {
+            Chunk& chunk = chunks[c];
+            if (!frustum.Intersects(chunk.boundsMin, chunk.boundsMax))
+                continue;
+
+            unsigned int level = SelectLevel(chunk, cameraPosition, focal);
+            if (chunk.VAO[level] == 0 && builds < maxBuildsPerFrame)
+            {
+                BuildLevel(chunk, level);
+                builds++;
+            }
+            while (chunk.VAO[level] == 0)
+                level++;
+
+            GlobalGLState().BindVertexArray(chunk.VAO[level]);
+            glDrawElements(GL_TRIANGLES, chunk.cells[level] * 6, GL_UNSIGNED_SHORT, 0);
+            chunksDrawn++;
+            cellsDrawn += chunk.cells[level];
+        }
+        return chunksDrawn;
+    }
+
+    // chunks and quads submitted by the last Draw
+    unsigned int ChunksDrawn() const { return chunksDrawn; }
+    unsigned int CellsDrawn() const { return cellsDrawn; }
+    unsigned int Chunks() const { return (unsigned int)chunks.size(); }
+
+    void Delete()
+    {
+        for (unsigned int c = 0; c < chunks.size(); c++)
+        {
+            for (unsigned int l = 0; l < LEVELS; l++)
+            {
+                if (chunks[c].VAO[l] != 0)
+                {
+                    GlobalGLState().DeleteVertexArrays(1, &chunks[c].VAO[l]);
+                    GlobalGLState().DeleteBuffers(1, &chunks[c].VBO[l]);
+                }
+            }
+        }
+        chunks.clear();
+        if (EBO != 0)
+            GlobalGLState().DeleteBuffers(1, &EBO);
+        EBO = 0;
+    }
+
+private:
+    // position on the xz plane and the two colors as normalized bytes, 16 bytes
+    struct TileVertex
+    {
+        float x, z;
+        GLubyte ambient[4];
+        GLubyte diffuse[4];
+    };
+
+    struct Chunk
+    {
+        glm::vec3 boundsMin, boundsMax;
+        unsigned int tileX, tileZ;
+        unsigned int tilesX, tilesZ;
+        // 0 until the level is built
+        unsigned int VAO[LEVELS];
+        unsigned int VBO[LEVELS];
+        unsigned int cells[LEVELS];
+    };
+
+    unsigned int tilesX, tilesZ;
+    glm::vec2 origin;
+    float tileSize;
+    std::vector<unsigned char> tiles;
+    std::vector<TileMaterial> palette;
+    std::vector<Chunk> chunks;
+    unsigned int EBO;
+    unsigned int chunksDrawn, cellsDrawn;
+
+    // coarsest level whose cells, seen from the nearest point of the chunk, are at most maxCellPixels wide
+    unsigned int SelectLevel(const Chunk& chunk, const glm::vec3& cameraPosition, float focal) const
+    {
+        glm::vec3 nearest = glm::clamp(cameraPosition, chunk.boundsMin, chunk.boundsMax);
+        float distance = glm::length(cameraPosition - nearest);
+
+        unsigned int level = 0;
+        while (level + 1 < LEVELS && tileSize * (float)(2u << level) * focal <= maxCellPixels * distance)
+            level++;
+        return level;
+    }
+
+    static void ToBytes(const glm::vec3& color, GLubyte bytes[4])
+    {
+        for (int k = 0; k < 3; k++)
+            bytes[k] = (GLubyte)(glm::clamp(color[k], 0.0f, 1.0f) * 255.0f + 0.5f);
+        bytes[3] = 255;
+    }
+
+    void BuildLevel(Chunk& chunk, unsigned int level)
+    {
+        const unsigned int cellTiles = 1u << level;
+        const unsigned int cellsX = (chunk.tilesX + cellTiles - 1) / cellTiles;
+        const unsigned int cellsZ = (chunk.tilesZ + cellTiles - 1) / cellTiles;
+
+        std::vector<TileVertex> vertices;
+        vertices.reserve(cellsX * cellsZ * 4);
+        for (unsigned int cz = 0; cz < cellsZ; cz++)
+        {
+            for (unsigned int cx = 0; cx < cellsX; cx++)
+            {
+                // the cell is clipped to the chunk, its color is the average of the tiles it covers
+                unsigned int x0 = chunk.tileX + cx * cellTiles, x1 = std::min(x0 + cellTiles, chunk.tileX + chunk.tilesX);
+                unsigned int z0 = chunk.tileZ + cz * cellTiles, z1 = std::min(z0 + cellTiles, chunk.tileZ + chunk.tilesZ);
+                glm::vec3 ambient(0.0f), diffuse(0.0f);
+                for (unsigned int z = z0; z < z1; z++)
+                {
+                    for (unsigned int x = x0; x < x1; x++)
+                    {
+                        const TileMaterial& material = palette[tiles[(size_t)z * tilesX + x]];
+                        ambient += material.ambient;
+                        diffuse += material.diffuse;
+                    }
+                }
+                float count = (float)((x1 - x0) * (z1 - z0));
+
+                TileVertex vertex;
+                ToBytes(ambient / count, vertex.ambient);
+                ToBytes(diffuse / count, vertex.diffuse);
+                const unsigned int corners[4][2] = { { x0, z0 }, { x1, z0 }, { x1, z1 }, { x0, z1 } };
+                for (int k = 0; k < 4; k++)
+                {
+                    vertex.x = origin.x + corners[k][0] * tileSize;
+                    vertex.z = origin.y + corners[k][1] * tileSize;
+                    vertices.push_back(vertex);
+                }
+            }
+        }
+        chunk.cells[level] = cellsX * cellsZ;
+
+        glGenVertexArrays(1, &chunk.VAO[level]);
+        glGenBuffers(1, &chunk.VBO[level]);
+        GlobalGLState().BindVertexArray(chunk.VAO[level]);
+        GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, chunk.VBO[level]);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TileVertex), &vertices[0], GL_STATIC_DRAW);
+        GlobalGLState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TileVertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TileVertex), (void*)(2 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TileVertex), (void*)(2 * sizeof(float) + 4));
+        GlobalGLState().BindVertexArray(0);
+    }
+};
+#endif
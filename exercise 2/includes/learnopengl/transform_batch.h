@@ -0,0 +1,329 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/particle_store.h>
+#include <learnopengl/normal_matrix.h>
+
+#include <cstddef>
+#include <vector>
+
+#if defined(NORMAL_MATRIX_AVX)
+#define TRANSFORM_BATCH_AVX
+#elif defined(NORMAL_MATRIX_SSE)
+#define TRANSFORM_BATCH_SSE
+#endif
+
+// Lane operations of the transform kernel: the same code runs on float (one object), __m128 (4 objects)
+// and __m256 (8 objects), every lane holding the same component of a different object.
+// ------------------------------------------------------------------------
+struct TransformScalarLanes
+{
+    typedef float V;
+    static V Load(const float* p) { return *p; }
+    static V Set(float value) { return value; }
+    static V Mul(V a, V b) { return a * b; }
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V Div(V a, V b) { return a / b; }
+};
+
+#if defined(TRANSFORM_BATCH_AVX)
+struct TransformVectorLanes
+{
+    typedef __m256 V;
+    static const std::size_t COUNT = 8;
+    static V Load(const float* p) { return _mm256_loadu_ps(p); }
+    static V Set(float value) { return _mm256_set1_ps(value); }
+    static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+};
+#elif defined(TRANSFORM_BATCH_SSE)
+struct TransformVectorLanes
+{
+    typedef __m128 V;
+    static const std::size_t COUNT = 4;
+    static V Load(const float* p) { return _mm_loadu_ps(p); }
+    static V Set(float value) { return _mm_set1_ps(value); }
+    static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V Add(V a, V b) { return _mm_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V Div(V a, V b) { return _mm_div_ps(a, b); }
+};
+#endif
+
+// x, y and z rows of the columns of the model matrices (the last row is always 0 0 0 1) and of the normal matrices
+template <typename Lanes>
+struct TransformColumns
+{
+    typedef typename Lanes::V V;
+    V m0x, m0y, m0z, m1x, m1y, m1z, m2x, m2y, m2z, m3x, m3y, m3z;
+    V n0x, n0y, n0z, n1x, n1y, n1z, n2x, n2y, n2z;
+};
+
+// writes the matrices of one object
+inline void TransformStore(const TransformColumns<TransformScalarLanes>& c, glm::mat4* models, glm::mat3* normals)
+{
+    models[0] = glm::mat4(c.m0x, c.m0y, c.m0z, 0.0f, c.m1x, c.m1y, c.m1z, 0.0f, c.m2x, c.m2y, c.m2z, 0.0f, c.m3x, c.m3y, c.m3z, 1.0f);
+    if (normals != NULL)
+        normals[0] = glm::mat3(c.n0x, c.n0y, c.n0z, c.n1x, c.n1y, c.n1z, c.n2x, c.n2y, c.n2z);
+}
+
+#if defined(TRANSFORM_BATCH_AVX)
+// writes the matrices of 8 objects: the rows are transposed back to one column per object, objects j and j + 4
+// sharing a 256-bit register
+inline void TransformStore(const TransformColumns<TransformVectorLanes>& c, glm::mat4* models, glm::mat3* normals)
+{
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    __m256 t0, t1, t2, t3;
+    float* out = &models[0][0][0];
+
+    // column k of object j at out + 16 * j + 4 * k
+    NormalMatrixPackColumn(c.m0x, c.m0y, c.m0z, t0, t1, t2, t3);
+    t0 = _mm256_blend_ps(t0, zero, 0x88); t1 = _mm256_blend_ps(t1, zero, 0x88);
+    t2 = _mm256_blend_ps(t2, zero, 0x88); t3 = _mm256_blend_ps(t3, zero, 0x88);
+    _mm_storeu_ps(out, _mm256_castps256_ps128(t0)); _mm_storeu_ps(out + 64, _mm256_extractf128_ps(t0, 1));
+    _mm_storeu_ps(out + 16, _mm256_castps256_ps128(t1)); _mm_storeu_ps(out + 80, _mm256_extractf128_ps(t1, 1));
+    _mm_storeu_ps(out + 32, _mm256_castps256_ps128(t2)); _mm_storeu_ps(out + 96, _mm256_extractf128_ps(t2, 1));
+    _mm_storeu_ps(out + 48, _mm256_castps256_ps128(t3)); _mm_storeu_ps(out + 112, _mm256_extractf128_ps(t3, 1));
+
+    NormalMatrixPackColumn(c.m1x, c.m1y, c.m1z, t0, t1, t2, t3);
+    t0 = _mm256_blend_ps(t0, zero, 0x88); t1 = _mm256_blend_ps(t1, zero, 0x88);
+    t2 = _mm256_blend_ps(t2, zero, 0x88); t3 = _mm256_blend_ps(t3, zero, 0x88);
+    _mm_storeu_ps(out + 4, _mm256_castps256_ps128(t0)); _mm_storeu_ps(out + 68, _mm256_extractf128_ps(t0, 1));
+    _mm_storeu_ps(out + 20, _mm256_castps256_ps128(t1)); _mm_storeu_ps(out + 84, _mm256_extractf128_ps(t1, 1));
+    _mm_storeu_ps(out + 36, _mm256_castps256_ps128(t2)); _mm_storeu_ps(out + 100, _mm256_extractf128_ps(t2, 1));
+    _mm_storeu_ps(out + 52, _mm256_castps256_ps128(t3)); _mm_storeu_ps(out + 116, _mm256_extractf128_ps(t3, 1));
+
+    NormalMatrixPackColumn(c.m2x, c.m2y, c.m2z, t0, t1, t2, t3);
+    t0 = _mm256_blend_ps(t0, zero, 0x88); t1 = _mm256_blend_ps(t1, zero, 0x88);
+    t2 = _mm256_blend_ps(t2, zero, 0x88); t3 = _mm256_blend_ps(t3, zero, 0x88);
+    _mm_storeu_ps(out + 8, _mm256_castps256_ps128(t0)); _mm_storeu_ps(out + 72, _mm256_extractf128_ps(t0, 1));
+    _mm_storeu_ps(out + 24, _mm256_castps256_ps128(t1)); _mm_storeu_ps(out + 88, _mm256_extractf128_ps(t1, 1));
+    _mm_storeu_ps(out + 40, _mm256_castps256_ps128(t2)); _mm_storeu_ps(out + 104, _mm256_extractf128_ps(t2, 1));
+    _mm_storeu_ps(out + 56, _mm256_castps256_ps128(t3)); _mm_storeu_ps(out + 120, _mm256_extractf128_ps(t3, 1));
+
+    NormalMatrixPackColumn(c.m3x, c.m3y, c.m3z, t0, t1, t2, t3);
+    t0 = _mm256_blend_ps(t0, one, 0x88); t1 = _mm256_blend_ps(t1, one, 0x88);
+    t2 = _mm256_blend_ps(t2, one, 0x88); t3 = _mm256_blend_ps(t3, one, 0x88);
+    _mm_storeu_ps(out + 12, _mm256_castps256_ps128(t0)); _mm_storeu_ps(out + 76, _mm256_extractf128_ps(t0, 1));
+    _mm_storeu_ps(out + 28, _mm256_castps256_ps128(t1)); _mm_storeu_ps(out + 92, _mm256_extractf128_ps(t1, 1));
+    _mm_storeu_ps(out + 44, _mm256_castps256_ps128(t2)); _mm_storeu_ps(out + 108, _mm256_extractf128_ps(t2, 1));
+    _mm_storeu_ps(out + 60, _mm256_castps256_ps128(t3)); _mm_storeu_ps(out + 124, _mm256_extractf128_ps(t3, 1));
+
+    if (normals == NULL)
+        return;
+
+    __m256 p00, p01, p02, p03, p10, p11, p12, p13, p20, p21, p22, p23;
+    NormalMatrixPackColumn(c.n0x, c.n0y, c.n0z, p00, p01, p02, p03);
+    NormalMatrixPackColumn(c.n1x, c.n1y, c.n1z, p10, p11, p12, p13);
+    NormalMatrixPackColumn(c.n2x, c.n2y, c.n2z, p20, p21, p22, p23);
+
+    float* normal = &normals[0][0][0];
+    NormalMatrixStoreColumns(normal, _mm256_castps256_ps128(p00), _mm256_castps256_ps128(p10), _mm256_castps256_ps128(p20));
+    NormalMatrixStoreColumns(normal + 9, _mm256_castps256_ps128(p01), _mm256_castps256_ps128(p11), _mm256_castps256_ps128(p21));
+    NormalMatrixStoreColumns(normal + 18, _mm256_castps256_ps128(p02), _mm256_castps256_ps128(p12), _mm256_castps256_ps128(p22));
+    NormalMatrixStoreColumns(normal + 27, _mm256_castps256_ps128(p03), _mm256_castps256_ps128(p13), _mm256_castps256_ps128(p23));
+    NormalMatrixStoreColumns(normal + 36, _mm256_extractf128_ps(p00, 1), _mm256_extractf128_ps(p10, 1), _mm256_extractf128_ps(p20, 1));
+    NormalMatrixStoreColumns(normal + 45, _mm256_extractf128_ps(p01, 1), _mm256_extractf128_ps(p11, 1), _mm256_extractf128_ps(p21, 1));
+    NormalMatrixStoreColumns(normal + 54, _mm256_extractf128_ps(p02, 1), _mm256_extractf128_ps(p12, 1), _mm256_extractf128_ps(p22, 1));
+    NormalMatrixStoreLastColumns(normal + 63, _mm256_extractf128_ps(p03, 1), _mm256_extractf128_ps(p13, 1), _mm256_extractf128_ps(p23, 1));
+}
+#elif defined(TRANSFORM_BATCH_SSE)
+// w of a packed column, which NormalMatrixPackColumn leaves holding z
+inline __m128 TransformSetW(__m128 column, __m128 w)
+{
+    // (z, z, w, w), then (x, y, z, w)
+    __m128 zw = _mm_shuffle_ps(column, w, _MM_SHUFFLE(3, 3, 2, 2));
+    return _mm_shuffle_ps(column, zw, _MM_SHUFFLE(2, 0, 1, 0));
+}
+
+// writes the matrices of 4 objects
+inline void TransformStore(const TransformColumns<TransformVectorLanes>& c, glm::mat4* models, glm::mat3* normals)
+{
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 t0, t1, t2, t3;
+    float* out = &models[0][0][0];
+
+    NormalMatrixPackColumn(c.m0x, c.m0y, c.m0z, t0, t1, t2, t3);
+    _mm_storeu_ps(out, TransformSetW(t0, zero)); _mm_storeu_ps(out + 16, TransformSetW(t1, zero));
+    _mm_storeu_ps(out + 32, TransformSetW(t2, zero)); _mm_storeu_ps(out + 48, TransformSetW(t3, zero));
+    NormalMatrixPackColumn(c.m1x, c.m1y, c.m1z, t0, t1, t2, t3);
+    _mm_storeu_ps(out + 4, TransformSetW(t0, zero)); _mm_storeu_ps(out + 20, TransformSetW(t1, zero));
+    _mm_storeu_ps(out + 36, TransformSetW(t2, zero)); _mm_storeu_ps(out + 52, TransformSetW(t3, zero));
+    NormalMatrixPackColumn(c.m2x, c.m2y, c.m2z, t0, t1, t2, t3);
+    _mm_storeu_ps(out + 8, TransformSetW(t0, zero)); _mm_storeu_ps(out + 24, TransformSetW(t1, zero));
+    _mm_storeu_ps(out + 40, TransformSetW(t2, zero)); _mm_storeu_ps(out + 56, TransformSetW(t3, zero));
+    NormalMatrixPackColumn(c.m3x, c.m3y, c.m3z, t0, t1, t2, t3);
+    _mm_storeu_ps(out + 12, TransformSetW(t0, one)); _mm_storeu_ps(out + 28, TransformSetW(t1, one));
+    _mm_storeu_ps(out + 44, TransformSetW(t2, one)); _mm_storeu_ps(out + 60, TransformSetW(t3, one));
+
+    if (normals == NULL)
+        return;
+
+    __m128 p00, p01, p02, p03, p10, p11, p12, p13, p20, p21, p22, p23;
+    NormalMatrixPackColumn(c.n0x, c.n0y, c.n0z, p00, p01, p02, p03);
+    NormalMatrixPackColumn(c.n1x, c.n1y, c.n1z, p10, p11, p12, p13);
+    NormalMatrixPackColumn(c.n2x, c.n2y, c.n2z, p20, p21, p22, p23);
+
+    float* normal = &normals[0][0][0];
+    NormalMatrixStoreColumns(normal, p00, p10, p20);
+    NormalMatrixStoreColumns(normal + 9, p01, p11, p21);
+    NormalMatrixStoreColumns(normal + 18, p02, p12, p22);
+    NormalMatrixStoreLastColumns(normal + 27, p03, p13, p23);
+}
+#endif
+
+// Structure-of-arrays transforms of many objects (position, unit quaternion rotation and scale, one array per
+// component, like ParticleStore) turned into packed model and normal matrices a vector register at a time,
+// ready to be uploaded to an instance or uniform buffer. The normal matrix of a translate-rotate-scale transform
+// is the rotation with every column divided by its scale, so unlike NormalMatrices no inverse is needed.
+// ------------------------------------------------------------------------
+class TransformBatch
+{
+public:
+    std::vector<float, AlignedAllocator<float> > px, py, pz;
+    std::vector<float, AlignedAllocator<float> > qx, qy, qz, qw;
+    std::vector<float, AlignedAllocator<float> > sx, sy, sz;
+
+    TransformBatch(std::size_t count = 0)
+    {
+        Resize(count);
+    }
+
+    // new objects get the identity transform
+    void Resize(std::size_t count)
+    {
+        px.resize(count, 0.0f);
+        py.resize(count, 0.0f);
+        pz.resize(count, 0.0f);
+        qx.resize(count, 0.0f);
+        qy.resize(count, 0.0f);
+        qz.resize(count, 0.0f);
+        qw.resize(count, 1.0f);
+        sx.resize(count, 1.0f);
+        sy.resize(count, 1.0f);
+        sz.resize(count, 1.0f);
+    }
+
+    std::size_t Size() const
+    {
+        return px.size();
+    }
+
+    void Set(std::size_t i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        px[i] = position.x;
+        py[i] = position.y;
+        pz[i] = position.z;
+        qx[i] = rotation.x;
+        qy[i] = rotation.y;
+        qz[i] = rotation.z;
+        qw[i] = rotation.w;
+        sx[i] = scale.x;
+        sy[i] = scale.y;
+        sz[i] = scale.z;
+    }
+
+    // models[i] = parent * translate(p[i]) * mat4_cast(q[i]) * scale(s[i]), the same matrix SceneNode builds;
+    // normals, if not NULL, receives their normal matrices. The parent must be affine (last row 0 0 0 1)
+    // and the scales not 0.
+    void Compute(const glm::mat4& parent, glm::mat4* models, glm::mat3* normals) const
+    {
+        const Parent p(parent);
+        std::size_t i = 0;
+#if defined(TRANSFORM_BATCH_AVX) || defined(TRANSFORM_BATCH_SSE)
+        for (; i + TransformVectorLanes::COUNT <= Size(); i += TransformVectorLanes::COUNT)
+            ComputeLanes<TransformVectorLanes>(i, p, models, normals);
+#endif
+        ComputeScalar(i, Size(), parent, models, normals);
+    }
+
+    void Compute(glm::mat4* models, glm::mat3* normals) const
+    {
+        Compute(glm::mat4(1.0f), models, normals);
+    }
+
+    // the objects [first, last) one at a time, also the reference for the vector kernels
+    void ComputeScalar(std::size_t first, std::size_t last, const glm::mat4& parent, glm::mat4* models, glm::mat3* normals) const
+    {
+        const Parent p(parent);
+        for (std::size_t i = first; i < last; i++)
+            ComputeLanes<TransformScalarLanes>(i, p, models, normals);
+    }
+
+private:
+    // the parent matrix and its normal matrix, the 3x3 parts and the translation
+    struct Parent
+    {
+        float m[12];
+        float n[9];
+
+        explicit Parent(const glm::mat4& parent)
+        {
+            glm::mat3 normal = NormalMatrix(parent);
+            for (int c = 0; c < 4; c++)
+                for (int r = 0; r < 3; r++)
+                    m[c * 3 + r] = parent[c][r];
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    n[c * 3 + r] = normal[c][r];
+        }
+    };
+
+    // the matrices of the objects [i, i + lanes)
+    template <typename Lanes>
+    void ComputeLanes(std::size_t i, const Parent& p, glm::mat4* models, glm::mat3* normals) const
+    {
+        typedef typename Lanes::V V;
+        const V x = Lanes::Load(&qx[i]), y = Lanes::Load(&qy[i]), z = Lanes::Load(&qz[i]), w = Lanes::Load(&qw[i]);
+        const V one = Lanes::Set(1.0f), two = Lanes::Set(2.0f);
+
+        // rotation matrix of the quaternion, as in glm::mat3_cast
+        const V x2 = Lanes::Mul(x, two), y2 = Lanes::Mul(y, two), z2 = Lanes::Mul(z, two);
+        const V xx = Lanes::Mul(x, x2), yy = Lanes::Mul(y, y2), zz = Lanes::Mul(z, z2);
+        const V xy = Lanes::Mul(x, y2), xz = Lanes::Mul(x, z2), yz = Lanes::Mul(y, z2);
+        const V wx = Lanes::Mul(w, x2), wy = Lanes::Mul(w, y2), wz = Lanes::Mul(w, z2);
+        const V r0x = Lanes::Sub(one, Lanes::Add(yy, zz)), r0y = Lanes::Add(xy, wz), r0z = Lanes::Sub(xz, wy);
+        const V r1x = Lanes::Sub(xy, wz), r1y = Lanes::Sub(one, Lanes::Add(xx, zz)), r1z = Lanes::Add(yz, wx);
+        const V r2x = Lanes::Add(xz, wy), r2y = Lanes::Sub(yz, wx), r2z = Lanes::Sub(one, Lanes::Add(xx, yy));
+
+        const V scaleX = Lanes::Load(&sx[i]), scaleY = Lanes::Load(&sy[i]), scaleZ = Lanes::Load(&sz[i]);
+
+        TransformColumns<Lanes> c = TransformColumns<Lanes>();
+        // parent * (rotation column * scale), parent * position + parent translation
+        Multiply<Lanes>(p.m, Lanes::Mul(r0x, scaleX), Lanes::Mul(r0y, scaleX), Lanes::Mul(r0z, scaleX), c.m0x, c.m0y, c.m0z);
+        Multiply<Lanes>(p.m, Lanes::Mul(r1x, scaleY), Lanes::Mul(r1y, scaleY), Lanes::Mul(r1z, scaleY), c.m1x, c.m1y, c.m1z);
+        Multiply<Lanes>(p.m, Lanes::Mul(r2x, scaleZ), Lanes::Mul(r2y, scaleZ), Lanes::Mul(r2z, scaleZ), c.m2x, c.m2y, c.m2z);
+        Multiply<Lanes>(p.m, Lanes::Load(&px[i]), Lanes::Load(&py[i]), Lanes::Load(&pz[i]), c.m3x, c.m3y, c.m3z);
+        c.m3x = Lanes::Add(c.m3x, Lanes::Set(p.m[9]));
+        c.m3y = Lanes::Add(c.m3y, Lanes::Set(p.m[10]));
+        c.m3z = Lanes::Add(c.m3z, Lanes::Set(p.m[11]));
+
+        // parent normal matrix * (rotation column / scale)
+        if (normals != NULL)
+        {
+            const V inverseX = Lanes::Div(one, scaleX), inverseY = Lanes::Div(one, scaleY), inverseZ = Lanes::Div(one, scaleZ);
+            Multiply<Lanes>(p.n, Lanes::Mul(r0x, inverseX), Lanes::Mul(r0y, inverseX), Lanes::Mul(r0z, inverseX), c.n0x, c.n0y, c.n0z);
+            Multiply<Lanes>(p.n, Lanes::Mul(r1x, inverseY), Lanes::Mul(r1y, inverseY), Lanes::Mul(r1z, inverseY), c.n1x, c.n1y, c.n1z);
+            Multiply<Lanes>(p.n, Lanes::Mul(r2x, inverseZ), Lanes::Mul(r2y, inverseZ), Lanes::Mul(r2z, inverseZ), c.n2x, c.n2y, c.n2z);
+        }
+
+        TransformStore(c, models + i, normals != NULL ? normals + i : NULL);
+    }
+
+    // (rx, ry, rz) = the 3x3 matrix m (column major) times (x, y, z)
+    template <typename Lanes>
+    static void Multiply(const float m[9], typename Lanes::V x, typename Lanes::V y, typename Lanes::V z,
+                         typename Lanes::V& rx, typename Lanes::V& ry, typename Lanes::V& rz)
+    {
+        rx = Lanes::Add(Lanes::Add(Lanes::Mul(Lanes::Set(m[0]), x), Lanes::Mul(Lanes::Set(m[3]), y)), Lanes::Mul(Lanes::Set(m[6]), z));
+        ry = Lanes::Add(Lanes::Add(Lanes::Mul(Lanes::Set(m[1]), x), Lanes::Mul(Lanes::Set(m[4]), y)), Lanes::Mul(Lanes::Set(m[7]), z));
+        rz = Lanes::Add(Lanes::Add(Lanes::Mul(Lanes::Set(m[2]), x), Lanes::Mul(Lanes::Set(m[5]), y)), Lanes::Mul(Lanes::Set(m[8]), z));
+    }
+};
+#endif
@@ -0,0 +1,62 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free single producer / single consumer triple buffer.
+// The producer fills Back() and publishes it, the consumer picks up the newest published value with Acquire().
+// Neither side ever waits for the other: the three slots are only swapped through an atomic exchange on the middle one,
+// and values published while the consumer was busy are simply overwritten by newer ones.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : back(0), front(1), middle(2)
+    {
+    }
+
+    // fills every slot, so that Front() is valid before the first Publish()
+    void Reset(const T& value)
+    {
+        for (int i = 0; i < 3; i++)
+            buffers[i] = value;
+    }
+
+    // producer side: the slot being written
+    T& Back()
+    {
+        return buffers[back];
+    }
+
+    // producer side: hands the back slot over to the consumer and takes the middle one for the next write
+    void Publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // consumer side: moves to the newest published slot, returns false if nothing new was published
+    bool Acquire()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // consumer side: the slot being read
+    const T& Front() const
+    {
+        return buffers[front];
+    }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    T buffers[3];
+    // back is only touched by the producer and front by the consumer, so they live on separate cache lines
+    alignas(64) unsigned int back;
+    alignas(64) unsigned int front;
+    alignas(64) std::atomic<unsigned int> middle;
+};
+#endif
@@ -0,0 +1,151 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstddef>
+#include <vector>
+
+// C++ mirrors of the std140 uniform blocks declared by the light_casters shaders.
+// In std140 a vec3 is aligned to 16 bytes but only 12 bytes long, so every vec3 is followed by a float that
+// fills its last 4 bytes; the static_asserts check that the C++ layout is exactly the GLSL one.
+// ------------------------------------------------------------------------
+
+// binding points of the blocks, shared by all the programs
+const GLuint LIGHT_BLOCK_BINDING = 0;
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+
+// layout (std140) uniform LightBlock { ... } light;
+struct LightBlock
+{
+    glm::vec3 position;
+    float cutOff;
+    glm::vec3 direction;
+    float outerCutOff;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+static_assert(offsetof(LightBlock, position) == 0, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, cutOff) == 12, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, direction) == 16, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, outerCutOff) == 28, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, ambient) == 32, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, constant) == 44, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, diffuse) == 48, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, linear) == 60, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, specular) == 64, "LightBlock layout does not match std140");
+static_assert(offsetof(LightBlock, quadratic) == 76, "LightBlock layout does not match std140");
+static_assert(sizeof(LightBlock) == 80, "LightBlock layout does not match std140");
+
+// layout (std140) uniform MaterialBlock { ... } material;
+struct MaterialBlock
+{
+    glm::vec3 ambient;
+    float shininess;
+    glm::vec3 diffuse;
+    float padding0;
+    glm::vec3 specular;
+    float padding1;
+
+    MaterialBlock() : ambient(0.0f), shininess(0.0f), diffuse(0.0f), padding0(0.0f), specular(0.0f), padding1(0.0f)
+    {
+    }
+    MaterialBlock(const glm::vec3& materialAmbient, const glm::vec3& materialDiffuse, const glm::vec3& materialSpecular, float materialShininess)
+        : ambient(materialAmbient), shininess(materialShininess), diffuse(materialDiffuse), padding0(0.0f), specular(materialSpecular), padding1(0.0f)
+    {
+    }
+};
+static_assert(offsetof(MaterialBlock, ambient) == 0, "MaterialBlock layout does not match std140");
+static_assert(offsetof(MaterialBlock, shininess) == 12, "MaterialBlock layout does not match std140");
+static_assert(offsetof(MaterialBlock, diffuse) == 16, "MaterialBlock layout does not match std140");
+static_assert(offsetof(MaterialBlock, specular) == 32, "MaterialBlock layout does not match std140");
+static_assert(sizeof(MaterialBlock) == 48, "MaterialBlock layout does not match std140");
+
+// connects the named uniform block of a program to a binding point (GLSL 330 has no layout(binding = N))
+inline void BindUniformBlock(GLuint program, const char* blockName, GLuint binding)
+{
+    GLuint index = glGetUniformBlockIndex(program, blockName);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, binding);
+}
+
+// Uniform buffer holding an array of blocks of the same type. Each block starts at a multiple of
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, so any of them can be bound on its own with glBindBufferRange:
+// static data (e.g. all the materials of a scene) is uploaded once and objects only switch the bound range.
+template <typename Block>
+class UniformBuffer
+{
+public:
+    unsigned int ID;
+
+    UniformBuffer() : ID(0), binding(0), stride(0), count(0)
+    {
+    }
+
+    void Create(GLuint bindingPoint, unsigned int blockCount, GLenum usage)
+    {
+        binding = bindingPoint;
+        count = blockCount;
+
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment <= 0)
+            alignment = 256;
+        stride = ((GLsizeiptr)sizeof(Block) + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &ID);
+        GlobalGLState().BindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, stride * count, NULL, usage);
+    }
+
+    // creates the buffer already filled with the given blocks
+    void Create(GLuint bindingPoint, const std::vector<Block>& blocks)
+    {
+        Create(bindingPoint, (unsigned int)blocks.size(), GL_STATIC_DRAW);
+
+        std::vector<unsigned char> data(stride * count, 0);
+        for (unsigned int i = 0; i < count; i++)
+            *(Block*)&data[i * stride] = blocks[i];
+
+        GlobalGLState().BindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, data.size(), &data[0]);
+    }
+
+    // the generic GL_UNIFORM_BUFFER binding is not used by any draw, so the buffer is left bound there
+    void Update(unsigned int index, const Block& block)
+    {
+        GlobalGLState().BindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, index * stride, sizeof(Block), &block);
+    }
+
+    // makes the block at index the one seen by every program at the binding point
+    void Bind(unsigned int index) const
+    {
+        GlobalGLState().BindUniformRange(binding, ID, index * stride, sizeof(Block));
+    }
+
+    unsigned int Size() const
+    {
+        return count;
+    }
+
+    void Delete()
+    {
+        GlobalGLState().DeleteBuffers(1, &ID);
+        ID = 0;
+        count = 0;
+    }
+
+private:
+    GLuint binding;
+    GLsizeiptr stride;
+    unsigned int count;
+};
+#endif
@@ -0,0 +1,167 @@
+#ifndef UNIFORM_CACHE_H
+#define UNIFORM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 64-bit FNV-1a hash of a uniform name; constexpr, so names known at compile time are hashed by the compiler
+constexpr uint64_t UniformHash(const char* name, uint64_t hash = 14695981039346656037ull)
+{
+    return *name ? UniformHash(name + 1, (hash ^ (uint8_t)*name) * 1099511628211ull) : hash;
+}
+
+// Uniform name together with its hash. String literals convert to it implicitly; declaring it
+// `static constexpr UniformName NAME("name");` guarantees the hash is computed at compile time.
+struct UniformName
+{
+    const char* name;
+    uint64_t hash;
+
+    constexpr UniformName(const char* uniformName) : name(uniformName), hash(UniformHash(uniformName))
+    {
+    }
+    UniformName(const std::string& uniformName) : name(uniformName.c_str()), hash(UniformHash(uniformName.c_str()))
+    {
+    }
+};
+
+// Resolved uniform location, for the setters that do no lookup at all. slot indexes the shadow value kept
+// by the UniformCache it came from (-1 for a bare location, which is then always uploaded).
+struct UniformLocation
+{
+    GLint value;
+    int slot;
+
+    explicit UniformLocation(GLint location = -1, int shadowSlot = -1) : value(location), slot(shadowSlot)
+    {
+    }
+};
+
+// Uniform uploads of all the programs, counted since the last reset (e.g. once per frame).
+struct UniformCounters
+{
+    // glUniform* calls issued
+    unsigned long long uploaded;
+    // calls skipped because the uniform already held the value (or is not active)
+    unsigned long long skipped;
+
+    UniformCounters() : uploaded(0), skipped(0)
+    {
+    }
+};
+
+inline UniformCounters& GlobalUniformCounters()
+{
+    static UniformCounters counters;
+    return counters;
+}
+
+// Name hash -> location map of one program. It is filled with every active uniform right after linking,
+// names that are not active (optimized out or misspelled) are resolved on first use and cached as -1.
+// Every location also has a shadow copy of the last value uploaded through it: uniforms are program state,
+// so setting the same value again is a driver call that changes nothing and is skipped by Changed().
+// The shadow only knows about uploads made through the Shader setters.
+class UniformCache
+{
+public:
+    // largest value shadowed, a mat4
+    static const std::size_t MAX_VALUE_BYTES = 16 * sizeof(float);
+
+    void Build(GLuint program)
+    {
+        locations.clear();
+        slots.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+            UniformLocation location = AddSlot(glGetUniformLocation(program, &name[0]));
+            locations[UniformHash(&name[0])] = location;
+
+            // arrays are reported as "name[0]", but are usually set through "name"
+            std::string full(&name[0]);
+            if (full.size() > 3 && full.compare(full.size() - 3, 3, "[0]") == 0)
+                locations[UniformHash(full.substr(0, full.size() - 3).c_str())] = location;
+        }
+    }
+
+    UniformLocation Find(GLuint program, const UniformName& name)
+    {
+        std::unordered_map<uint64_t, UniformLocation, IdentityHash>::const_iterator it = locations.find(name.hash);
+        if (it != locations.end())
+            return it->second;
+
+        UniformLocation location = AddSlot(glGetUniformLocation(program, name.name));
+        locations[name.hash] = location;
+        return location;
+    }
+
+    // true if the value differs from the shadow of the location, which then takes the new value;
+    // false if the upload can be skipped
+    bool Changed(UniformLocation location, const void* value, std::size_t bytes)
+    {
+        UniformCounters& counters = GlobalUniformCounters();
+        if (location.value == -1)
+        {
+            counters.skipped++;
+            return false;
+        }
+        if (location.slot < 0 || bytes > MAX_VALUE_BYTES)
+        {
+            counters.uploaded++;
+            return true;
+        }
+
+        Slot& slot = slots[location.slot];
+        if (slot.bytes == bytes && std::memcmp(slot.value, value, bytes) == 0)
+        {
+            counters.skipped++;
+            return false;
+        }
+        std::memcpy(slot.value, value, bytes);
+        slot.bytes = (unsigned int)bytes;
+        counters.uploaded++;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        unsigned char value[MAX_VALUE_BYTES];
+        // 0 until the first upload
+        unsigned int bytes;
+    };
+
+    // the keys already are good hashes
+    struct IdentityHash
+    {
+        std::size_t operator()(uint64_t hash) const { return (std::size_t)hash; }
+    };
+
+    std::unordered_map<uint64_t, UniformLocation, IdentityHash> locations;
+    std::vector<Slot> slots;
+
+    UniformLocation AddSlot(GLint location)
+    {
+        if (location == -1)
+            return UniformLocation();
+
+        Slot slot;
+        slot.bytes = 0;
+        slots.push_back(slot);
+        return UniformLocation(location, (int)slots.size() - 1);
+    }
+};
+#endif
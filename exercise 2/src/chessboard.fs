@@ -0,0 +1,104 @@
+#version 330 core
+
+/*  Fragment shader of the chessboard, drawn as a single quad (light_casters.vs with an identity model).
+ *  The tile under each fragment is found from its position on the board, so the number of tiles costs nothing
+ *  on the CPU and nothing in vertices; the two tile materials come from ChessboardBlock and are blended by the
+ *  fraction of the pixel footprint covered by each color, which keeps far and tiny tiles from aliasing.
+ *  The lighting is the one of light_casters.fs.
+*/
+
+out vec4 FragColor;
+
+struct Material {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// tiles[0] is the color of the tiles with an odd i + j, tiles[1] of the even ones (ChessboardBlock in exercise_2.cpp)
+layout (std140) uniform ChessboardBlock {
+    Material tiles[2];
+};
+
+// same light block as light_casters.fs
+layout (std140) uniform LightBlock {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+} light;
+
+in vec3 FragPos;  
+in vec3 Normal;  
+
+uniform bool spotlight;
+uniform vec3 viewPos;
+// corner of the first tile on the xz plane, and side of a tile
+uniform vec2 boardOrigin;
+uniform float tileSize;
+
+// fraction of the pixel footprint covered by tiles with an even i + j: the checker pattern box-filtered over the
+// footprint, exact (0 or 1) inside a tile and a smooth blend where the pixel straddles edges
+float evenCoverage(vec2 p)
+{
+    vec2 w = fwidth(p) + 1e-4;
+    // integral of the square wave +1 on even cells, -1 on odd ones, averaged over [p - w/2, p + w/2]
+    vec2 s = 2.0 * (abs(fract((p - 0.5 * w) * 0.5) - 0.5) - abs(fract((p + 0.5 * w) * 0.5) - 0.5)) / w;
+    return 0.5 + 0.5 * s.x * s.y;
+}
+
+void main()
+{   
+    float even = evenCoverage((FragPos.xz - boardOrigin) / tileSize);
+    Material material;
+    material.ambient = mix(tiles[0].ambient, tiles[1].ambient, even);
+    material.diffuse = mix(tiles[0].diffuse, tiles[1].diffuse, even);
+    material.specular = mix(tiles[0].specular, tiles[1].specular, even);
+    material.shininess = mix(tiles[0].shininess, tiles[1].shininess, even);
+
+    // ambient
+    vec3 ambient = light.ambient * material.ambient;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 normal = normalize(Normal);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    vec3 specular = light.specular * (spec * material.specular); // assuming bright white light color
+    
+    if(spotlight)
+    {
+        // spotlight (soft edges)
+        float theta = dot(lightDir, normalize(-light.direction)); 
+        float epsilon = (light.cutOff - light.outerCutOff);
+        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+        diffuse  *= intensity;
+        specular *= intensity;
+    }
+
+    // attenuation
+    float distance = length(light.position - FragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    
+    ambient  *= attenuation; 
+    diffuse  *= attenuation;
+    specular *= attenuation;   
+        
+    vec3 result = ambient + diffuse + specular; 
+
+    FragColor = vec4(result, 1.0);
+}
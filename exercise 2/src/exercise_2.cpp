@@ -21,20 +21,34 @@
 
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/sphere_lod.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/render_state.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/static_scene.h>
+#include <learnopengl/streaming_buffer.h>
+#include <learnopengl/transform_batch.h>
+#include <learnopengl/tile_world.h>
 
 #include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window, glm::vec4 object_position[]);
-void renderSphere(unsigned int X_SEGMENTS, unsigned int Y_SEGMENTS);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-const unsigned int NUMBER_CHESSBOARD_TILES = 25;
+// tiles per side of the chessboard (--tiles N); the board is one quad whatever its size
+unsigned int chessboard_tiles = 25;
+const unsigned int MAX_CHESSBOARD_TILES = 4096;
+const float TILE_SIZE = 0.1f;
+const glm::vec2 BOARD_ORIGIN(-0.9f, -0.9f);
 const unsigned int OBJECTS_NUMBER = 4;
 
 // camera
@@ -45,16 +59,99 @@ bool firstMouse = true;
 
 bool light_changer = false;
 bool switcher_press = false;
+// the board is either the analytic chessboard quad or the chunked tile map (--tile-world, toggled with T)
+bool tile_world_board = false;
+bool tile_world_press = false;
+// the board, the spheres and the cube are drawn with a single multi-draw where the context supports it
+// (--no-multi-draw submits them one by one through the render queue instead)
+bool multi_draw = true;
+// how the per-draw data and the commands of the multi-draw reach the GPU every frame (--stream orphan|subdata|persistent)
+StreamingStrategy streaming_strategy = STREAMING_PERSISTENT;
 
 // timing
 float deltaTime = 0.0f;	
 float lastFrame = 0.0f;
+float lastTitleUpdate = 0.0f;
 
 // lighting
 glm::vec3 lightPos(0.40f, 2.0, 0.40f);
 
-int main()
+// sphere meshes, one per level of detail
+SphereLod sphere_lod;
+
+// light and material uniform blocks: the light is written once per frame, the materials of the three spheres
+// and of the cube are uploaded once and each object binds its own
+UniformBuffer<LightBlock> light_buffer;
+UniformBuffer<MaterialBlock> material_buffer;
+const unsigned int SPHERE_MATERIALS = 0;
+const unsigned int CUBE_MATERIAL = 3;
+// specular and shininess of the tile map, whose tiles bring their own ambient and diffuse colors
+const unsigned int TILE_WORLD_MATERIAL = 4;
+
+// the same board as a map of tiles, drawn by chunks
+TileWorld tile_world;
+
+// the two tile materials of chessboard.fs, read as an array: std140 lays out an array of the Material struct
+// exactly like consecutive MaterialBlocks
+struct ChessboardBlock
 {
+    MaterialBlock tiles[2];
+};
+static_assert(offsetof(ChessboardBlock, tiles) == 0, "ChessboardBlock layout does not match std140");
+static_assert(sizeof(ChessboardBlock) == 96, "ChessboardBlock layout does not match std140");
+const GLuint CHESSBOARD_BLOCK_BINDING = 2;
+UniformBuffer<ChessboardBlock> chessboard_buffer;
+
+// every material of the multi-draw scene in one block, indexed by the draws (static_scene.fs): the objects and the
+// tile world at the indices they have in material_buffer, followed by the two tiles of the chessboard
+const unsigned int MAX_SCENE_MATERIALS = 8;
+struct SceneMaterialsBlock
+{
+    MaterialBlock materials[MAX_SCENE_MATERIALS];
+};
+static_assert(sizeof(SceneMaterialsBlock) == 48 * MAX_SCENE_MATERIALS, "SceneMaterialsBlock layout does not match std140");
+const GLuint SCENE_MATERIALS_BLOCK_BINDING = 3;
+const unsigned int SCENE_TILE_MATERIALS = 5;
+UniformBuffer<SceneMaterialsBlock> scene_material_buffer;
+
+// the board, the cube and every level of the sphere in shared buffers, drawn with one glMultiDrawElementsIndirect
+StaticScene static_scene;
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--tiles") == 0 && i + 1 < argc)
+        {
+            char* end = NULL;
+            long tiles = std::strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || tiles < 1 || tiles > (long)MAX_CHESSBOARD_TILES)
+            {
+                std::cout << "--tiles takes a count from 1 to " << MAX_CHESSBOARD_TILES << ", not " << argv[i] << std::endl;
+                return -1;
+            }
+            chessboard_tiles = (unsigned int)tiles;
+        }
+        else if (std::strcmp(argv[i], "--tile-world") == 0)
+            tile_world_board = true;
+        else if (std::strcmp(argv[i], "--no-multi-draw") == 0)
+            multi_draw = false;
+        else if (std::strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+        {
+            // the flag picks the strategy to measure, so a misspelled one must not fall back silently
+            StreamingStrategy strategy = StreamingBuffer::Parse(argv[++i], STREAMING_STRATEGIES);
+            if (strategy == STREAMING_STRATEGIES)
+            {
+                std::cout << "--stream takes";
+                for (int s = 0; s < STREAMING_STRATEGIES; s++)
+                    std::cout << (s == 0 ? " " : (s + 1 == STREAMING_STRATEGIES ? " or " : ", ")) << StreamingBuffer::Name((StreamingStrategy)s);
+                std::cout << ", not " << argv[i] << std::endl;
+                return -1;
+            }
+            streaming_strategy = strategy;
+        }
+    }
+
     //  We first initialize GLFW in order to configure it.
     glfwInit();
 
@@ -112,13 +209,34 @@ int main()
         return -1;
     }
 
-    // configure global opengl state
+    // fixed-function state of every draw: the board, the spheres and the cube are all opaque and depth tested
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    const RenderState OPAQUE_STATE;
+    // draws of the frame, recorded in any order and issued sorted by program, material and vertex array
+    RenderQueue render_queue;
 
     // build and compile our shader zprogram
     // ------------------------------------
     Shader ourShader("light_casters.vs", "light_casters.fs");
+    BindUniformBlock(ourShader.ID, "LightBlock", LIGHT_BLOCK_BINDING);
+    BindUniformBlock(ourShader.ID, "MaterialBlock", MATERIAL_BLOCK_BINDING);
+    Shader chessboardShader("light_casters.vs", "chessboard.fs");
+    BindUniformBlock(chessboardShader.ID, "LightBlock", LIGHT_BLOCK_BINDING);
+    BindUniformBlock(chessboardShader.ID, "ChessboardBlock", CHESSBOARD_BLOCK_BINDING);
+    chessboardShader.use();
+    chessboardShader.setVec2("boardOrigin", BOARD_ORIGIN);
+    chessboardShader.setFloat("tileSize", TILE_SIZE);
+    Shader tileWorldShader("tile_world.vs", "tile_world.fs");
+    BindUniformBlock(tileWorldShader.ID, "LightBlock", LIGHT_BLOCK_BINDING);
+    BindUniformBlock(tileWorldShader.ID, "MaterialBlock", MATERIAL_BLOCK_BINDING);
+    Shader staticSceneShader("static_scene.vs", "static_scene.fs");
+    BindUniformBlock(staticSceneShader.ID, "LightBlock", LIGHT_BLOCK_BINDING);
+    BindUniformBlock(staticSceneShader.ID, "SceneMaterialsBlock", SCENE_MATERIALS_BLOCK_BINDING);
+    staticSceneShader.use();
+    staticSceneShader.setVec2("boardOrigin", BOARD_ORIGIN);
+    staticSceneShader.setFloat("tileSize", TILE_SIZE);
+
+    sphere_lod.Build();
 
     /*  In order to start drawing something we have to first give OpenGL some input vertex data. 
      *  OpenGL is a 3D graphics library so all coordinates that we specify in OpenGL are in 3D(x, y and z coordinate).
@@ -132,17 +250,20 @@ int main()
     */
 
 
-    /* In this case we define all the vertex 3D positions needed to draw each tile of the chessboard.
-     * Since each tile is composed from two triangle 6 vertex 3D positions have been defined. 
+    /* In this case we define all the vertex 3D positions needed to draw the whole chessboard.
+     * The board is a single square composed from two triangles, so 6 vertex 3D positions have been defined;
+     * the tiles are drawn on it by the fragment shader (chessboard.fs). 
      */
+    const float board_min_x = BOARD_ORIGIN.x, board_min_z = BOARD_ORIGIN.y;
+    const float board_max_x = board_min_x + chessboard_tiles * TILE_SIZE, board_max_z = board_min_z + chessboard_tiles * TILE_SIZE;
     float tile_vertices[] = {
-        // positions        //normals
-        -0.9f, 0.0f, -0.9f, 0.0f, 1.0f, 0.0f,
-        -0.8f, 0.0f, -0.9f, 0.0f, 1.0f, 0.0f,
-        -0.8f, 0.0f, -0.8f, 0.0f, 1.0f, 0.0f,
-        -0.8f, 0.0f, -0.8f, 0.0f, 1.0f, 0.0f,
-        -0.9f, 0.0f, -0.8f, 0.0f, 1.0f, 0.0f,
-        -0.9f, 0.0f, -0.9f, 0.0f, 1.0f, 0.0f,
+        // positions                            //normals
+        board_min_x, 0.0f, board_min_z,         0.0f, 1.0f, 0.0f,
+        board_max_x, 0.0f, board_min_z,         0.0f, 1.0f, 0.0f,
+        board_max_x, 0.0f, board_max_z,         0.0f, 1.0f, 0.0f,
+        board_max_x, 0.0f, board_max_z,         0.0f, 1.0f, 0.0f,
+        board_min_x, 0.0f, board_max_z,         0.0f, 1.0f, 0.0f,
+        board_min_x, 0.0f, board_min_z,         0.0f, 1.0f, 0.0f,
     };
 
     /* In this case we define all the vertex 3D positions needed to draw a cube within the scene.
@@ -199,6 +320,8 @@ int main()
         glm::vec4(0.7f, 0.0f, 0.2f, 0.15),
         glm::vec4(0.6f, 0.07f, 0.8f, 0.15),
     };
+    // their transforms, turned into model and normal matrices once per frame
+    TransformBatch object_transforms(4);
 
     glm::vec3 tile_ambient_diffuse[2][2] =
     {
@@ -215,6 +338,40 @@ int main()
         {glm::vec3(0.18f, 0.0f, 0.0f),  glm::vec3(0.61f, 0.07568f, 0.07568f)},
     };
 
+    ChessboardBlock chessboard;
+    for (int i = 0; i < 2; i++)
+        chessboard.tiles[i] = MaterialBlock(tile_ambient_diffuse[i][0], tile_ambient_diffuse[i][1], glm::vec3(1.0f, 1.0f, 1.0f), 128.0f);
+    chessboard_buffer.Create(CHESSBOARD_BLOCK_BINDING, std::vector<ChessboardBlock>(1, chessboard));
+    chessboard_buffer.Bind(0);
+
+    // the tile (i, j) is at x = i, z = j, the same colors as the chessboard quad
+    std::vector<unsigned char> tile_map((size_t)chessboard_tiles * chessboard_tiles);
+    for (unsigned int j = 0; j < chessboard_tiles; j++)
+        for (unsigned int i = 0; i < chessboard_tiles; i++)
+            tile_map[(size_t)j * chessboard_tiles + i] = (i + j) % 2 == 0 ? 1 : 0;
+    std::vector<TileMaterial> tile_palette;
+    for (int i = 0; i < 2; i++)
+        tile_palette.push_back(TileMaterial(tile_ambient_diffuse[i][0], tile_ambient_diffuse[i][1]));
+    tile_world.Build(chessboard_tiles, chessboard_tiles, BOARD_ORIGIN, TILE_SIZE, tile_map, tile_palette);
+
+    std::vector<MaterialBlock> materials;
+    for (int i = 0; i < 3; i++)
+        materials.push_back(MaterialBlock(object_ambient_diffuse[i][0], object_ambient_diffuse[i][1], glm::vec3(0.94f, 0.94f, 0.94f), 111.0f));
+    materials.push_back(MaterialBlock(glm::vec3(0.67f, 0.0f, 0.0f), glm::vec3(1.0f, 0.67f, 0.41f), glm::vec3(0.94f, 0.94f, 0.94f), 111.0f));
+    materials.push_back(MaterialBlock(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f, 1.0f, 1.0f), 128.0f));
+    material_buffer.Create(MATERIAL_BLOCK_BINDING, materials);
+
+    SceneMaterialsBlock scene_materials;
+    for (unsigned int i = 0; i < materials.size(); i++)
+        scene_materials.materials[i] = materials[i];
+    for (int i = 0; i < 2; i++)
+        scene_materials.materials[SCENE_TILE_MATERIALS + i] = chessboard.tiles[i];
+    scene_material_buffer.Create(SCENE_MATERIALS_BLOCK_BINDING, std::vector<SceneMaterialsBlock>(1, scene_materials));
+    scene_material_buffer.Bind(0);
+
+    light_buffer.Create(LIGHT_BLOCK_BINDING, 1, GL_DYNAMIC_DRAW);
+    light_buffer.Bind(0);
+
     /*  With the vertex data defined for the tiles and the cube we'd like to send it as input to the first process 
      *  of the graphics pipeline: the vertex shader. 
      *  This is done by creating memory on the GPU where we store the vertex data, configure how OpenGL should interpret 
@@ -250,13 +407,13 @@ int main()
      *  and then unbind the VAO for later use. 
      *  As soon as we want to draw an object, we simply bind the VAO with the preferred settings before drawing the object and that is it. 
     */
-    glBindVertexArray(tileVAO);
+    GlobalGLState().BindVertexArray(tileVAO);
 
     /*  OpenGL has many types of buffer objectsand the buffer type of a vertex buffer object is GL_ARRAY_BUFFER.
      *  OpenGL allows us to bind to several buffers at once as long as they have a different buffer type.
      *  We can bind the newly created buffer to the GL_ARRAY_BUFFER target with the glBindBuffer function.
     */
-    glBindBuffer(GL_ARRAY_BUFFER, tileVBO);
+    GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, tileVBO);
 
     /*  The glBufferData function copies the previously defined vertex data into the buffer's memory. 
      *  glBufferData is a function specifically targeted to copy user-defined data into the currently bound buffer. 
@@ -301,17 +458,17 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindBuffer(GL_ARRAY_BUFFER, tileVBO);
+    GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, tileVBO);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     unsigned int cubeVBO, cubeVAO;
     glGenVertexArrays(1, &cubeVAO);
-    glBindVertexArray(cubeVAO);
+    GlobalGLState().BindVertexArray(cubeVAO);
     glGenBuffers(1, &cubeVBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    GlobalGLState().BindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
 
     // position attribute
@@ -321,6 +478,27 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
+    // the same meshes once more in the shared buffers of the multi-draw, all as indexed triangles;
+    // glMultiDrawElementsIndirect needs GL 4.3, older contexts keep drawing through the render queue
+    multi_draw = multi_draw && StaticScene::Supported();
+    unsigned int board_mesh = 0, cube_mesh = 0, sphere_meshes[SphereLod::LEVELS] = { 0 };
+    if (multi_draw)
+    {
+        std::vector<unsigned int> sequence;
+        for (unsigned int i = 0; i < 36; i++)
+            sequence.push_back(i);
+        board_mesh = static_scene.AddMesh(std::vector<float>(tile_vertices, tile_vertices + 6 * 6), std::vector<unsigned int>(sequence.begin(), sequence.begin() + 6));
+        cube_mesh = static_scene.AddMesh(std::vector<float>(cube_vertices, cube_vertices + 36 * 6), sequence);
+        for (unsigned int i = 0; i < SphereLod::LEVELS; i++)
+        {
+            std::vector<float> sphere_vertices;
+            std::vector<unsigned int> sphere_indices;
+            SphereLod::Geometry(i, sphere_vertices, sphere_indices);
+            sphere_meshes[i] = static_scene.AddStripMesh(sphere_vertices, sphere_indices);
+        }
+        static_scene.Build(streaming_strategy);
+    }
+
     /*  We don't want the application to draw a single image and then immediately quit and close the window. 
      *  We want the application to keep drawing images and handling user input until the program has been explicitly told to stop. 
      *  For this reason we have to create a while loop, that we now call the render loop (frame), that keeps on running until we tell GLFW to stop. 
@@ -352,89 +530,145 @@ int main()
         */
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // get matrix's uniform location and set matrix
-        // be sure to activate shader when setting uniforms/drawing objects
-        ourShader.use();
-        ourShader.setVec3("light.position", lightPos);
-        ourShader.setVec3("light.direction", glm::vec3(0.0f, -1.0f, 0.0f));
-        ourShader.setFloat("light.cutOff", glm::cos(glm::radians(12.5f)));
-        ourShader.setFloat("light.outerCutOff", glm::cos(glm::radians(17.5f)));
-        ourShader.setVec3("viewPos", camera.Position);
-
-        // light properties
-        ourShader.setVec3("light.ambient", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("light.diffuse", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-        ourShader.setFloat("light.constant", 1.0f);
-        ourShader.setFloat("light.linear", 0.09f);
-        ourShader.setFloat("light.quadratic", 0.032f);
-
-        ourShader.setBool("spotlight", light_changer);
+        // light properties, a single buffer update
+        LightBlock light;
+        light.position = lightPos;
+        light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        light.cutOff = glm::cos(glm::radians(12.5f));
+        light.outerCutOff = glm::cos(glm::radians(17.5f));
+        light.ambient = glm::vec3(1.0f, 1.0f, 1.0f);
+        light.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+        light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        light.constant = 1.0f;
+        light.linear = 0.09f;
+        light.quadratic = 0.032f;
+        light_buffer.Update(0, light);
 
         // pass projection matrix to shader (note that in this case it could change every frame)
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection);
 
         // camera/view transformation
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("view", view);
 
         // create transformations
         glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-        ourShader.setMat4("model", model);
-        
-        glBindVertexArray(tileVAO);
 
-        ourShader.setVec3("material.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-        ourShader.setFloat("material.shininess", 128.0f);
-
-        bool color_switcher = true;
-        for (int i = 0; i < NUMBER_CHESSBOARD_TILES; i++)
-            for (int j = 0; j < NUMBER_CHESSBOARD_TILES; j++)
-            {
-                ourShader.setVec3("material.ambient", tile_ambient_diffuse[color_switcher][0]);
-                ourShader.setVec3("material.diffuse", tile_ambient_diffuse[color_switcher][1]);
+        // the three spheres and the cube, model and normal matrices computed in one batch
+        glm::mat4 object_models[4];
+        glm::mat3 object_normals[4];
+        for (int i = 0; i < 4; ++i)
+            object_transforms.Set(i, glm::vec3(object_position_size[i]), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(i < 3 ? 0.11f : 0.7f));
+        object_transforms.Compute(object_models, object_normals);
 
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, glm::vec3(i * 0.1f, 0.0f, j * 0.1f));
-                ourShader.setMat4("model", model);
+        // the draws are only recorded, and issued by the render queue (or the multi-draw) once the frame is complete;
+        // the uniforms shared by all the draws of a program are set on it right away
+        render_queue.Clear();
+        static_scene.Clear();
 
-                color_switcher = !color_switcher;
+        if (tile_world_board)
+        {
+            // the tile world culls its chunks and draws them itself, before the queue
+            GlobalGLState().Apply(OPAQUE_STATE);
+            // the chunks in view, the far ones with merged tiles
+            tileWorldShader.use();
+            tileWorldShader.setVec3("viewPos", camera.Position);
+            tileWorldShader.setBool("spotlight", light_changer);
+            tileWorldShader.setMat4("projection", projection);
+            tileWorldShader.setMat4("view", view);
+            material_buffer.Bind(TILE_WORLD_MATERIAL);
+            tile_world.Draw(view, projection, camera.Position, (float)SCR_HEIGHT);
+        }
+        else if (multi_draw)
+            static_scene.Add(board_mesh, model, glm::mat3(1.0f), SCENE_TILE_MATERIALS, SCENE_TILE_MATERIALS + 1);
+        else
+        {
+            // the whole chessboard, a single draw call whatever the number of tiles
+            chessboardShader.use();
+            chessboardShader.setVec3("viewPos", camera.Position);
+            chessboardShader.setBool("spotlight", light_changer);
+            chessboardShader.setMat4("projection", projection);
+            chessboardShader.setMat4("view", view);
+
+            /*  The glDrawArrays function takes as its first argument the OpenGL primitive type we would like to draw.
+             *      1.  Since we wanted to draw triangles, we pass in GL_TRIANGLES. 
+             *      2.  The second argument specifies the starting index of the vertex array we'd like to draw; we just leave this at 0. 
+             *      3.  The last argument specifies how many vertices we want to draw, which is 6 (the 2 triangles of the board).
+            */
+            render_queue.Add(chessboardShader, OPAQUE_STATE, 0.0f)
+                .SetModel(model)
+                .SetNormalMatrix(glm::mat3(1.0f))
+                .SetArrays(tileVAO, GL_TRIANGLES, 0, 6);
+        }
 
-                /*  The glDrawArrays function takes as its first argument the OpenGL primitive type we would like to draw.
-                 *      1.  Since we wanted to draw a triangle, we pass in GL_TRIANGLES. 
-                 *      2.  The second argument specifies the starting index of the vertex array we'd like to draw; we just leave this at 0. 
-                 *      3.  The last argument specifies how many vertices we want to draw, which is 3 (we only render 1 triangle from our data, which is exactly 3 vertices long).
-                */
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+        if (multi_draw)
+        {
+            // the board, the spheres and the cube in one call: each draw brings its matrices and materials
+            for (int i = 0; i < 3; ++i)
+            {
+                unsigned int level = sphere_lod.SelectLevel(glm::vec3(object_position_size[i]), 0.11f, view, projection, (float)SCR_HEIGHT);
+                static_scene.Add(sphere_meshes[level], object_models[i], object_normals[i], SPHERE_MATERIALS + i);
             }
-
-        ourShader.setVec3("material.specular", glm::vec3(0.94f, 0.94f, 0.94f));
-        ourShader.setFloat("material.shininess", 111.0f);
-
-        for (int i = 0; i < 3; ++i)
+            static_scene.Add(cube_mesh, object_models[3], object_normals[3], CUBE_MATERIAL);
+
+            staticSceneShader.use();
+            staticSceneShader.setVec3("viewPos", camera.Position);
+            staticSceneShader.setBool("spotlight", light_changer);
+            staticSceneShader.setMat4("projection", projection);
+            staticSceneShader.setMat4("view", view);
+            GlobalGLState().Apply(OPAQUE_STATE);
+            static_scene.Submit();
+        }
+        else
         {
-            ourShader.setVec3("material.ambient", object_ambient_diffuse[i][0]);
-            ourShader.setVec3("material.diffuse", object_ambient_diffuse[i][1]);
+            // get matrix's uniform location and set matrix
+            // be sure to activate shader when setting uniforms/drawing objects
+            ourShader.use();
+            ourShader.setVec3("viewPos", camera.Position);
+            ourShader.setBool("spotlight", light_changer);
+            ourShader.setMat4("projection", projection);
+            ourShader.setMat4("view", view);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                // as many segments as the sphere needs at its size on screen
+                glm::vec3 position(object_position_size[i]);
+                unsigned int level = sphere_lod.SelectLevel(position, 0.11f, view, projection, (float)SCR_HEIGHT);
+                render_queue.Add(ourShader, OPAQUE_STATE, RenderQueue::ViewDepth(view, position))
+                    .SetMaterial(material_buffer, SPHERE_MATERIALS + i)
+                    .SetModel(object_models[i])
+                    .SetNormalMatrix(object_normals[i])
+                    .SetElements(sphere_lod.VAO[level], GL_TRIANGLE_STRIP, sphere_lod.indexCount[level], GL_UNSIGNED_INT);
+            }
 
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(object_position_size[i].x, object_position_size[i].y, object_position_size[i].z));
-            model = glm::scale(model, glm::vec3(0.11f));
-            ourShader.setMat4("model", model);
+            render_queue.Add(ourShader, OPAQUE_STATE, RenderQueue::ViewDepth(view, glm::vec3(object_position_size[3])))
+                .SetMaterial(material_buffer, CUBE_MATERIAL)
+                .SetModel(object_models[3])
+                .SetNormalMatrix(object_normals[3])
+                .SetArrays(cubeVAO, GL_TRIANGLES, 0, 36);
 
-            renderSphere(32, 32);
+            render_queue.Submit();
         }
-        
-        ourShader.setVec3("material.ambient", glm::vec3(0.67f, 0.0f, 0.0f));
-        ourShader.setVec3("material.diffuse", glm::vec3(1.0f, 0.67f, 0.41f));
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(object_position_size[3].x, object_position_size[3].y, object_position_size[3].z));
-        model = glm::scale(model, glm::vec3(0.7f));
-        ourShader.setMat4("model", model);
-
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        // uniform uploads issued and skipped (value already set) in this frame, and the same for the binds and state changes,
+        // shown in the title once per second
+        UniformCounters frame_uniforms = GlobalUniformCounters();
+        GlobalUniformCounters() = UniformCounters();
+        GLStateCounters frame_calls = GlobalGLStateCounters();
+        GlobalGLStateCounters() = GLStateCounters();
+        if (currentFrame - lastTitleUpdate >= 1.0f)
+        {
+            std::ostringstream title;
+            title << "LearnOpenGL - uniforms per frame: " << frame_uniforms.uploaded << " uploaded, " << frame_uniforms.skipped << " skipped"
+                  << " - GL calls: " << frame_calls.issued << " issued, " << frame_calls.elided << " elided"
+                  << " - queue: " << render_queue.Size() << " draws, " << render_queue.ProgramChanges() << " program and "
+                  << render_queue.VertexArrayChanges() << " vertex array switches";
+            if (multi_draw)
+                title << " - multi-draw: " << static_scene.Submitted() << " draws in 1 call";
+            if (tile_world_board)
+                title << " - chunks: " << tile_world.ChunksDrawn() << "/" << tile_world.Chunks() << ", quads: " << tile_world.CellsDrawn();
+            glfwSetWindowTitle(window, title.str().c_str());
+            lastTitleUpdate = currentFrame;
+        }
         
         /*  The glfwSwapBuffers will swap the color buffer(a large 2D buffer that contains color values for each pixel in GLFW's window),
          *   that is used to render to during this render iteration and show it as output to the screen.
@@ -453,11 +687,19 @@ int main()
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
 
-    glDeleteVertexArrays(1, &tileVAO);
-    glDeleteBuffers(1, &tileVBO);
+    GlobalGLState().DeleteVertexArrays(1, &tileVAO);
+    GlobalGLState().DeleteBuffers(1, &tileVBO);
+
+    GlobalGLState().DeleteVertexArrays(1, &cubeVAO);
+    GlobalGLState().DeleteBuffers(1, &cubeVBO);
 
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteBuffers(1, &cubeVBO);
+    sphere_lod.Delete();
+    light_buffer.Delete();
+    material_buffer.Delete();
+    chessboard_buffer.Delete();
+    scene_material_buffer.Delete();
+    static_scene.Delete();
+    tile_world.Delete();
     
     /*  As soon as we exit the render loop we would like to properly clean/delete all of GLFW's resources that were allocated. 
      *  We can do this via the glfwTerminate function that we call at the end of the main function.
@@ -491,6 +733,15 @@ void processInput(GLFWwindow* window, glm::vec4 object_position[])
         light_changer = !light_changer;
     }
 
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE && tile_world_press)
+        tile_world_press = false;
+
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !tile_world_press)
+    {
+        tile_world_press = true;
+        tile_world_board = !tile_world_board;
+    }
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime, object_position, OBJECTS_NUMBER);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -546,90 +797,3 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(yoffset);
 }
-
-// renders (and builds at first invocation) a sphere
-// -------------------------------------------------
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
-void renderSphere(unsigned int X_SEGMENTS, unsigned int Y_SEGMENTS)
-{
-    if (sphereVAO == 0)
-    {
-        glGenVertexArrays(1, &sphereVAO);
-
-        unsigned int vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
-
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec3> normals;
-        std::vector<unsigned int> indices;
-
-        const float PI = 3.14159265359;
-        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
-        {
-            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-            {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
-            }
-        }
-
-        bool oddRow = false;
-        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
-        {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
-            {
-                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-                {
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                }
-            }
-            else
-            {
-                for (int x = X_SEGMENTS; x >= 0; --x)
-                {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                }
-            }
-            oddRow = !oddRow;
-        }
-        indexCount = indices.size();
-
-        std::vector<float> data;
-        for (unsigned int i = 0; i < positions.size(); ++i)
-        {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
-
-            if (normals.size() > 0)
-            {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
-            }
-        }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        float stride = (3 + 3) * sizeof(float);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    }
-
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
-}
\ No newline at end of file
@@ -17,6 +17,8 @@ out vec3 FragPos;
 out vec3 Normal;
 
 uniform mat4 model;
+// inverse transpose of the upper 3x3 of model, computed on the CPU (normal_matrix.h)
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 offset;
@@ -24,7 +26,7 @@ uniform vec3 offset;
 void main()
 {
 	FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal; 
+    Normal = normalMatrix * aNormal; 
 
     /*  To set the output of the vertex shader we have to assign the position data to the predefined 
      *  gl_Position variable which is a vec4 behind the scenes. 
@@ -0,0 +1,107 @@
+#version 330 core
+
+/*  Fragment shader of the static scene (see static_scene.vs).
+ *  All the materials of the scene are in one block, and each draw picks two of them: the same one twice for a plain
+ *  object, or the two tile materials of the chessboard, blended by the fraction of the pixel footprint covered by
+ *  each as in chessboard.fs. The lighting is the one of light_casters.fs.
+*/
+
+out vec4 FragColor;
+
+struct Material {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// every material of the scene (SceneMaterialsBlock in exercise_2.cpp)
+layout (std140) uniform SceneMaterialsBlock {
+    Material materials[8];
+};
+
+// same light block as light_casters.fs
+layout (std140) uniform LightBlock {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+} light;
+
+in vec3 FragPos;  
+in vec3 Normal;  
+flat in ivec2 Materials;
+
+uniform bool spotlight;
+uniform vec3 viewPos;
+// corner of the first tile on the xz plane, and side of a tile
+uniform vec2 boardOrigin;
+uniform float tileSize;
+
+// fraction of the pixel footprint covered by tiles with an even i + j (see chessboard.fs)
+float evenCoverage(vec2 p)
+{
+    vec2 w = fwidth(p) + 1e-4;
+    vec2 s = 2.0 * (abs(fract((p - 0.5 * w) * 0.5) - 0.5) - abs(fract((p + 0.5 * w) * 0.5) - 0.5)) / w;
+    return 0.5 + 0.5 * s.x * s.y;
+}
+
+void main()
+{   
+    Material material = materials[Materials.x];
+    if (Materials.x != Materials.y)
+    {
+        // Materials.x on the tiles with an odd i + j, Materials.y on the even ones
+        float even = evenCoverage((FragPos.xz - boardOrigin) / tileSize);
+        Material tile = materials[Materials.y];
+        material.ambient = mix(material.ambient, tile.ambient, even);
+        material.diffuse = mix(material.diffuse, tile.diffuse, even);
+        material.specular = mix(material.specular, tile.specular, even);
+        material.shininess = mix(material.shininess, tile.shininess, even);
+    }
+
+    // ambient
+    vec3 ambient = light.ambient * material.ambient;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 normal = normalize(Normal);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    vec3 specular = light.specular * (spec * material.specular); // assuming bright white light color
+    
+    if(spotlight)
+    {
+        // spotlight (soft edges)
+        float theta = dot(lightDir, normalize(-light.direction)); 
+        float epsilon = (light.cutOff - light.outerCutOff);
+        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+        diffuse  *= intensity;
+        specular *= intensity;
+    }
+
+    // attenuation
+    float distance = length(light.position - FragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    
+    ambient  *= attenuation; 
+    diffuse  *= attenuation;
+    specular *= attenuation;   
+        
+    vec3 result = ambient + diffuse + specular; 
+
+    FragColor = vec4(result, 1.0);
+}
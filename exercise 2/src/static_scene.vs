@@ -0,0 +1,28 @@
+#version 330 core
+
+/*  Vertex shader of the static scene drawn with one glMultiDrawElementsIndirect (learnopengl/static_scene.h).
+ *  The model and normal matrices and the materials of each draw are per-instance attributes: every draw has one
+ *  instance, and its baseInstance points it at its own element of the per-draw buffer (GLSL 330 has no gl_DrawID).
+*/
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in mat3 aNormalMatrix;
+layout (location = 9) in ivec2 aMaterials;
+
+out vec3 FragPos;
+out vec3 Normal;
+flat out ivec2 Materials;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = aNormalMatrix * aNormal;
+    Materials = aMaterials;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,78 @@
+#version 330 core
+
+/*  Fragment shader of the chunked tile map (see tile_world.vs).
+ *  The ambient and diffuse colors come from the tile, specular and shininess from the material block, which is
+ *  the same for every tile; the lighting is the one of light_casters.fs.
+*/
+
+out vec4 FragColor;
+
+layout (std140) uniform MaterialBlock {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+} material;
+
+// same light block as light_casters.fs
+layout (std140) uniform LightBlock {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+} light;
+
+in vec3 FragPos;
+flat in vec3 Ambient;
+flat in vec3 Diffuse;
+
+uniform bool spotlight;
+uniform vec3 viewPos;
+
+void main()
+{   
+    // ambient
+    vec3 ambient = light.ambient * Ambient;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 normal = vec3(0.0, 1.0, 0.0);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * (diff * Diffuse);
+    
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    vec3 specular = light.specular * (spec * material.specular); // assuming bright white light color
+    
+    if(spotlight)
+    {
+        // spotlight (soft edges)
+        float theta = dot(lightDir, normalize(-light.direction)); 
+        float epsilon = (light.cutOff - light.outerCutOff);
+        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+        diffuse  *= intensity;
+        specular *= intensity;
+    }
+
+    // attenuation
+    float distance = length(light.position - FragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    
+    ambient  *= attenuation; 
+    diffuse  *= attenuation;
+    specular *= attenuation;   
+        
+    vec3 result = ambient + diffuse + specular; 
+
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+/*  Vertex shader of the chunked tile map (learnopengl/tile_world.h).
+ *  The tiles lie on the xz plane, so a vertex only carries its x and z; its ambient and diffuse colors are the ones
+ *  of its tile, or the average of the tiles merged in its cell for the coarser levels of far chunks.
+*/
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec4 aAmbient;
+layout (location = 2) in vec4 aDiffuse;
+
+out vec3 FragPos;
+flat out vec3 Ambient;
+flat out vec3 Diffuse;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    FragPos = vec3(aPos.x, 0.0, aPos.y);
+    Ambient = aAmbient.rgb;
+    Diffuse = aDiffuse.rgb;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}